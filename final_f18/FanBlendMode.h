@@ -1,3 +1,6 @@
+#ifndef FanBlendMode_DEFINED
+#define FanBlendMode_DEFINED
+
 //Blend mode implementations
 
 static const GPixel kClear(GPixel& source, GPixel& dest) {	//!<     0
@@ -162,3 +165,40 @@ static const GPixel kXor(GPixel& source, GPixel& dest) { //!<     (1 - Sa)*D + (
 }
 
 static const GPixel(*BlendProc[12])(GPixel&, GPixel&) = { kClear, kSrc, kDst, kSrcOver, kDstOver, kSrcIn, kDstIn, kSrcOut, kDstOut, kSrcATop, kDstATop, kXor };
+
+// The mode that gives the same result for a source whose alpha is known to be 255 (opaque) or 0
+// (transparent, so every component is 0). Opaque SrcOver, for example, just stores the source.
+static inline GBlendMode ReduceBlendMode(GBlendMode mode, bool opaque, bool transparent) {
+	if (opaque) {
+		switch (mode) {
+			case GBlendMode::kSrcOver:  return GBlendMode::kSrc;      // S
+			case GBlendMode::kDstIn:    return GBlendMode::kDst;      // D
+			case GBlendMode::kDstOut:   return GBlendMode::kClear;    // 0
+			case GBlendMode::kSrcATop:  return GBlendMode::kSrcIn;    // Da*S
+			case GBlendMode::kDstATop:  return GBlendMode::kDstOver;  // D + (1 - Da)*S
+			case GBlendMode::kXor:      return GBlendMode::kSrcOut;   // (1 - Da)*S
+			default:                    return mode;
+		}
+	}
+	if (transparent) {
+		switch (mode) {
+			case GBlendMode::kSrcOver:
+			case GBlendMode::kDstOver:
+			case GBlendMode::kDstOut:
+			case GBlendMode::kSrcATop:
+			case GBlendMode::kXor:
+				return GBlendMode::kDst;
+			case GBlendMode::kSrc:
+			case GBlendMode::kSrcIn:
+			case GBlendMode::kDstIn:
+			case GBlendMode::kSrcOut:
+			case GBlendMode::kDstATop:
+				return GBlendMode::kClear;
+			default:
+				return mode;
+		}
+	}
+	return mode;
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef FanBlitRow_DEFINED
+#define FanBlitRow_DEFINED
+
+#include "include/GPixel.h"
+#include "include/GBlendMode.h"
+#include "include/GCpu.h"
+#include "Utils.h"
+#include "FanBlendMode.h"
+
+// Row kernels: blending one premultiplied source pixel into count destination pixels, and
+// premultiplying PNG rows.
+//
+// The vector kernels are written once against an Ops struct (a vector type plus the handful of
+// 16-bit lane operations they need) and instantiated per instruction set in FanCpu*.cpp, each
+// file compiled for its own target; GCpu() picks the set the CPU supports. They widen each
+// pixel to four 16-bit lanes and evaluate every mode as div255(S * fs + D * fd) (plus S or D
+// for the Over modes), which is what the BlendProc functions compute for premultiplied pixels,
+// so both give bit-identical results. Whatever does not fill a whole vector goes through the
+// scalar code.
+//
+// Only instantiate these with an Ops type that is defined in the same file: the templates are
+// compiled for whatever target that file is built for.
+
+typedef void (*BlendRowProcType)(GPixel src, GPixel dst[], int count);
+
+template <int Mode>
+static void blend_row_scalar(GPixel src, GPixel dst[], int count) {
+	for (int i = 0; i < count; ++i) {
+		dst[i] = (*BlendProc[Mode])(src, dst[i]);
+	}
+}
+
+// a * c / 255, rounded (as GBitmap::readFromFile always did it)
+static void premul_rgba_scalar(GPixel dst[], const uint8_t src[], int count) {
+	for (int i = 0; i < count; ++i) {
+		unsigned a = src[3];
+		dst[i] = GPixel_PackARGB(a, (a * src[0] + 127) / 255, (a * src[1] + 127) / 255,
+			(a * src[2] + 127) / 255);
+		src += 4;
+	}
+}
+
+// x / 255, rounded, for x <= 255 * 255 in each 16-bit lane (same as quad_div255)
+template <typename Ops>
+static inline typename Ops::V div255_lanes(typename Ops::V x) {
+	x = Ops::add(x, Ops::splat16(128));
+	return Ops::shr8(Ops::add(x, Ops::shr8(x)));
+}
+
+// s, d are widened pixels; sa, da their alphas in every lane
+template <int Mode, typename Ops>
+static inline typename Ops::V blend_lanes(typename Ops::V s, typename Ops::V sa,
+	typename Ops::V d, typename Ops::V da) {
+	typedef typename Ops::V V;
+	const V k255 = Ops::splat16(255);
+
+	switch (Mode) {
+		case (int)GBlendMode::kSrcOver:
+			return Ops::add(s, div255_lanes<Ops>(Ops::mul(d, Ops::sub(k255, sa))));
+		case (int)GBlendMode::kDstOver:
+			return Ops::add(d, div255_lanes<Ops>(Ops::mul(s, Ops::sub(k255, da))));
+		case (int)GBlendMode::kSrcIn:
+			return div255_lanes<Ops>(Ops::mul(s, da));
+		case (int)GBlendMode::kDstIn:
+			return div255_lanes<Ops>(Ops::mul(d, sa));
+		case (int)GBlendMode::kSrcOut:
+			return div255_lanes<Ops>(Ops::mul(s, Ops::sub(k255, da)));
+		case (int)GBlendMode::kDstOut:
+			return div255_lanes<Ops>(Ops::mul(d, Ops::sub(k255, sa)));
+		case (int)GBlendMode::kSrcATop:
+			return div255_lanes<Ops>(Ops::add(Ops::mul(s, da), Ops::mul(d, Ops::sub(k255, sa))));
+		case (int)GBlendMode::kDstATop:
+			return div255_lanes<Ops>(Ops::add(Ops::mul(d, sa), Ops::mul(s, Ops::sub(k255, da))));
+		case (int)GBlendMode::kXor:
+			return div255_lanes<Ops>(Ops::add(Ops::mul(d, Ops::sub(k255, sa)), Ops::mul(s, Ops::sub(k255, da))));
+		default:
+			return d;
+	}
+}
+
+template <int Mode, typename Ops>
+static void blend_row_vector(GPixel src, GPixel dst[], int count) {
+	typedef typename Ops::V V;
+	const V s = Ops::lo(Ops::splat(src));
+	const V sa = Ops::alpha(s);
+
+	int i = 0;
+	for (; i + Ops::kPixels <= count; i += Ops::kPixels) {
+		V d = Ops::load(dst + i);
+		V dlo = Ops::lo(d);
+		V dhi = Ops::hi(d);
+		dlo = blend_lanes<Mode, Ops>(s, sa, dlo, Ops::alpha(dlo));
+		dhi = blend_lanes<Mode, Ops>(s, sa, dhi, Ops::alpha(dhi));
+		Ops::store(dst + i, Ops::pack(dlo, dhi));
+	}
+	blend_row_scalar<Mode>(src, dst + i, count - i);
+}
+
+// [R G B A] lanes -> premultiplied [B G R A]
+template <typename Ops>
+static inline typename Ops::V premul_lanes(typename Ops::V c) {
+	typedef typename Ops::V V;
+	const V alphaLane = Ops::splat64(0xFFFF000000000000ull);
+	// scale r, g, b by a and a by 255
+	V scale = Ops::bitOr(Ops::bitAndNot(alphaLane, Ops::alpha(c)), Ops::bitAnd(alphaLane, Ops::splat16(255)));
+	return Ops::swapRB(div255_lanes<Ops>(Ops::mul(c, scale)));
+}
+
+template <typename Ops>
+static void premul_rgba_vector(GPixel dst[], const uint8_t src[], int count) {
+	typedef typename Ops::V V;
+
+	int i = 0;
+	for (; i + Ops::kPixels <= count; i += Ops::kPixels) {
+		V c = Ops::load((const GPixel*)(src + 4 * i));
+		Ops::store(dst + i, Ops::pack(premul_lanes<Ops>(Ops::lo(c)), premul_lanes<Ops>(Ops::hi(c))));
+	}
+	premul_rgba_scalar(dst + i, src + 4 * i, count - i);
+}
+
+// Fills in the modes that need arithmetic; Clear, Src, Dst and the SrcOver shortcuts are
+// shared by every level (see FanCpu.cpp).
+template <typename Ops>
+static void FillBlendRowProcs(BlendRowProcType procs[12]) {
+	procs[(int)GBlendMode::kSrcOver]  = blend_row_vector<(int)GBlendMode::kSrcOver, Ops>;
+	procs[(int)GBlendMode::kDstOver]  = blend_row_vector<(int)GBlendMode::kDstOver, Ops>;
+	procs[(int)GBlendMode::kSrcIn]    = blend_row_vector<(int)GBlendMode::kSrcIn, Ops>;
+	procs[(int)GBlendMode::kDstIn]    = blend_row_vector<(int)GBlendMode::kDstIn, Ops>;
+	procs[(int)GBlendMode::kSrcOut]   = blend_row_vector<(int)GBlendMode::kSrcOut, Ops>;
+	procs[(int)GBlendMode::kDstOut]   = blend_row_vector<(int)GBlendMode::kDstOut, Ops>;
+	procs[(int)GBlendMode::kSrcATop]  = blend_row_vector<(int)GBlendMode::kSrcATop, Ops>;
+	procs[(int)GBlendMode::kDstATop]  = blend_row_vector<(int)GBlendMode::kDstATop, Ops>;
+	procs[(int)GBlendMode::kXor]      = blend_row_vector<(int)GBlendMode::kXor, Ops>;
+}
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef FanBlitter_DEFINED
+#define FanBlitter_DEFINED
+
+#include "include/GBitmap.h"
+#include "include/GMatrix.h"
+#include "include/GPaint.h"
+#include "include/GShader.h"
+#include "Utils.h"
+#include "FanBlendMode.h"
+#include "FanBlitRow.h"
+
+// One blend, resolved at compile time. With kOpaque the caller promises the source alpha is
+// 255; setting it again lets the compiler fold away the branches on Sa.
+template <int Mode, bool kOpaque>
+static inline GPixel blend_pixel(GPixel s, GPixel d) {
+	if (kOpaque) {
+		s |= 0xFFu << GPIXEL_SHIFT_A;
+	}
+	switch (Mode) {
+		case (int)GBlendMode::kClear:    return kClear(s, d);
+		case (int)GBlendMode::kSrc:      return kSrc(s, d);
+		case (int)GBlendMode::kDst:      return kDst(s, d);
+		case (int)GBlendMode::kSrcOver:  return kSrcOver(s, d);
+		case (int)GBlendMode::kDstOver:  return kDstOver(s, d);
+		case (int)GBlendMode::kSrcIn:    return kSrcIn(s, d);
+		case (int)GBlendMode::kDstIn:    return kDstIn(s, d);
+		case (int)GBlendMode::kSrcOut:   return kSrcOut(s, d);
+		case (int)GBlendMode::kDstOut:   return kDstOut(s, d);
+		case (int)GBlendMode::kSrcATop:  return kSrcATop(s, d);
+		case (int)GBlendMode::kDstATop:  return kDstATop(s, d);
+		default:                         return kXor(s, d);
+	}
+}
+
+// Blends a paint into the device. It is set up once per draw: the blend mode (reduced by what
+// is known about the source's opacity) and the kind of source (color, shader, opaque shader)
+// pick a specialized row loop up front, so the spans themselves make one call and no per-pixel
+// indirect calls. Shaders get a single context for the whole draw; rows it reports as one
+// color go through the color path.
+class FanBlitter {
+public:
+	// scratch is the canvas's, with rows at least as wide as the device; the shader's colors
+	// go into one of them, and the shader's context may take more
+	FanBlitter(const GBitmap& device, const GPaint& paint, const GMatrix& ctm,
+		GShader::Scratch* scratch)
+		: fDevice(device)
+		, fColor(color_to_pixel(paint.getColor()))
+		, fStorage(scratch, device.width()) {
+		GShader* shader = paint.getShader();
+		if (shader) {
+			fOwnedContext = shader->makeContext(ctm);
+		}
+		fContext = fOwnedContext.get();
+		this->init(shader != nullptr, paint.getBlendMode(), paint.isOpaque(), scratch);
+	}
+
+	// Blends the colors of a context the caller keeps alive (and may retarget between spans)
+	// for as long as the blitter is used. With opaque the caller promises they are all opaque.
+	FanBlitter(const GBitmap& device, GShader::Context* context, GBlendMode mode, bool opaque,
+		GShader::Scratch* scratch)
+		: fDevice(device)
+		, fContext(context)
+		, fColor(0)
+		, fStorage(scratch, device.width()) {
+		this->init(true, mode, opaque, scratch);
+	}
+
+	// fills [x1, x2) of row y; an empty span (x2 <= x1) does nothing
+	void blitRow(int y, int x1, int x2) {
+		if (x2 <= x1) {
+			return;
+		}
+		(this->*fRowProc)(y, x1, x2 - x1);
+	}
+
+	// blends cov[i] (0...255) of the paint into pixel x + i of row y
+	void blitCoverage(int y, int x, int count, const uint8_t cov[]) {
+		if (count <= 0) {
+			return;
+		}
+		(this->*fCoverageProc)(y, x, count, cov);
+	}
+
+private:
+	enum {
+		kColor_Source,
+		kShader_Source,
+		kOpaqueShader_Source,
+		kSourceKinds,
+	};
+
+	typedef void (FanBlitter::*RowProc)(int y, int x, int count);
+	typedef void (FanBlitter::*CoverageProc)(int y, int x, int count, const uint8_t cov[]);
+
+	void init(bool shaded, GBlendMode blendMode, bool opaque, GShader::Scratch* scratch) {
+		if (fContext) {
+			fContext->setScratch(scratch);
+		}
+
+		bool transparent = !shaded && GPixel_GetA(fColor) == 0;
+		int mode = static_cast<int>(ReduceBlendMode(blendMode, opaque, transparent));
+		int kind = !shaded ? kColor_Source : opaque ? kOpaqueShader_Source : kShader_Source;
+		fBlendRow = GCpu().blendRow[mode];
+		fRowProc = Table().rows[kind][mode];
+		if (fContext && (fContext->flags() & GShader::Context::kConstantRow_Flag)) {
+			fRowProc = &FanBlitter::constantShaderRow;
+		}
+		fCoverageProc = Table().covs[kind][mode];
+	}
+
+	// fetches the shader's colors for a span; false if the shader cannot draw
+	bool shade(int y, int x, int count) {
+		if (!fContext) {
+			return false;
+		}
+		fContext->shadeRow(x, y, count, fStorage.get());
+		return true;
+	}
+
+	// pixel x of row y; x may be the width, for an empty span that ends the row
+	GPixel* addr(int x, int y) const {
+		return fDevice.getAddr(0, y) + x;
+	}
+
+	template <int Mode>
+	void colorRow(int y, int x, int count) {
+		fBlendRow(fColor, this->addr(x, y), count);
+	}
+
+	template <int Mode, bool kOpaque>
+	void shaderRow(int y, int x, int count) {
+		GPixel* row = this->addr(x, y);
+		if (Mode == (int)GBlendMode::kSrc) {
+			// store-only: the shader writes straight into the device
+			if (fContext) {
+				fContext->shadeRow(x, y, count, row);
+			}
+			return;
+		}
+		if (!this->shade(y, x, count)) {
+			return;
+		}
+		for (int i = 0; i < count; ++i) {
+			row[i] = blend_pixel<Mode, kOpaque>(fStorage.get()[i], row[i]);
+		}
+	}
+
+	// the shader gives each row one color: blend it like a paint color
+	void constantShaderRow(int y, int x, int count) {
+		GPixel src;
+		fContext->shadeRow(x, y, 1, &src);
+		fBlendRow(src, this->addr(x, y), count);
+	}
+
+	template <int Mode, int Kind>
+	void coverageRow(int y, int x, int count, const uint8_t cov[]) {
+		if (Kind != kColor_Source && !this->shade(y, x, count)) {
+			return;
+		}
+		GPixel* row = this->addr(x, y);
+		for (int i = 0; i < count; ++i) {
+			if (cov[i] == 0) {
+				continue;
+			}
+			GPixel src = Kind == kColor_Source ? fColor : fStorage.get()[i];
+			GPixel out = blend_pixel<Mode, Kind == kOpaqueShader_Source>(src, row[i]);
+			if (cov[i] != 255) {
+				out = lerp_pixel(out, row[i], cov[i]);
+			}
+			row[i] = out;
+		}
+	}
+
+	template <int Mode>
+	static void SetProcs(RowProc rows[kSourceKinds][12], CoverageProc covs[kSourceKinds][12]) {
+		rows[kColor_Source][Mode] = &FanBlitter::colorRow<Mode>;
+		rows[kShader_Source][Mode] = &FanBlitter::shaderRow<Mode, false>;
+		rows[kOpaqueShader_Source][Mode] = &FanBlitter::shaderRow<Mode, true>;
+		covs[kColor_Source][Mode] = &FanBlitter::coverageRow<Mode, kColor_Source>;
+		covs[kShader_Source][Mode] = &FanBlitter::coverageRow<Mode, kShader_Source>;
+		covs[kOpaqueShader_Source][Mode] = &FanBlitter::coverageRow<Mode, kOpaqueShader_Source>;
+	}
+
+	struct ProcTable {
+		RowProc rows[kSourceKinds][12];
+		CoverageProc covs[kSourceKinds][12];
+
+		ProcTable() {
+			SetProcs<0>(rows, covs);  SetProcs<1>(rows, covs);  SetProcs<2>(rows, covs);
+			SetProcs<3>(rows, covs);  SetProcs<4>(rows, covs);  SetProcs<5>(rows, covs);
+			SetProcs<6>(rows, covs);  SetProcs<7>(rows, covs);  SetProcs<8>(rows, covs);
+			SetProcs<9>(rows, covs);  SetProcs<10>(rows, covs); SetProcs<11>(rows, covs);
+		}
+	};
+
+	static const ProcTable& Table() {
+		static const ProcTable table;
+		return table;
+	}
+
+	const GBitmap fDevice;
+	std::unique_ptr<GShader::Context> fOwnedContext;
+	GShader::Context* fContext;
+	GPixel fColor;
+	GShader::Scratch::Row fStorage;
+	BlendRowProcType fBlendRow;
+	RowProc fRowProc;
+	CoverageProc fCoverageProc;
+};
+
+#endif
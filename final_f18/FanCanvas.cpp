@@ -9,7 +9,10 @@
 #include "include/GPath.h"
 #include "Utils.h"
 #include "GEdge.h"
+#include "GCoverage.h"
+#include "GSupersample.h"
 #include "FanBlendMode.h"
+#include "FanBlitter.h"
 #include "include/GShader.h"
 #include "include/GPoint.h"
 #include <iostream>
@@ -19,16 +22,30 @@
 #include <algorithm>
 #include <iterator>
 #include "FanShader.h"
+#include "FanMesh.h"
 
 
 
 class FanCanvas : public GCanvas {
 public:
 
-	FanCanvas(const GBitmap& device) : fDevice(device) {
+	FanCanvas(const GBitmap& device)
+		: fDevice(device), fClipTop(0), fClipBottom(device.height()), fScratch(device.width())
+		, fQuadIndexLevel(-1) {
 		CTM_stack.push(GMatrix());
 	}
 
+	// Restricts drawing to the rows [top, bottom). Edges are still set up and stepped from the
+	// full geometry, so the pixels drawn are exactly the ones an unrestricted canvas would draw.
+	void setBand(int top, int bottom) {
+		fClipTop = std::max(0, top);
+		fClipBottom = std::min(fDevice.height(), bottom);
+	}
+
+	void setMatrix(const GMatrix& matrix) {
+		CTM_stack.top() = matrix;
+	}
+
 	std::unique_ptr<GShader> final_createRadialGradient(GPoint center, float radius,
 		const GColor colors[], int count, GShader::TileMode mode) {
 
@@ -51,45 +68,19 @@ public:
 
 
 	void drawPaint(const GPaint& paint) override {
+		FanBlitter blitter(fDevice, paint, CTM_stack.top(), &fScratch);
 
-		
-
-		if (paint.getShader()) {
-			// use the shader instead of the paint�s color
-			if (!paint.getShader()->setContext(CTM_stack.top())) {
-				// nothing to draw if the shader fails
-				return;
-			}
-
-			paint.getShader()->setContext(CTM_stack.top());
-			GShader* shader = paint.getShader();
-			GPixel storage[fDevice.width()];
-
-			for (int y = 0; y < fDevice.height(); ++y) {
-				GPixel* row = fDevice.getAddr(0, y);
-				shader->shadeRow(0, y, fDevice.width(), storage);
-
-				for (int x = 0; x < fDevice.width(); x++) {
-					row[x] = (*BlendProc[static_cast<int>(paint.getBlendMode())])(storage[x], row[x]);
-				}
-
-			}
-
-			return;
-		}
-
-		GPixel source = color_to_pixel(paint.getColor());
-
-		for (int y = 0; y < fDevice.height(); ++y) {
-			GPixel* row = fDevice.getAddr(0, y);
-			for (int x = 0; x < fDevice.width(); ++x) {
-				row[x] = (*BlendProc[static_cast<int>(paint.getBlendMode())])(source, row[x]);
-			}
+		for (int y = fClipTop; y < fClipBottom; ++y) {
+			blitter.blitRow(y, 0, fDevice.width());
 		}
 	}
 
 	void drawRect(const GRect& rect, const GPaint& paint) override {
 
+		if (drawAlignedRect(rect, paint)) {
+			return;
+		}
+
 		//send to draw polygon
 		GPoint points[4];
 		points[0].set(rect.fLeft, rect.fTop);
@@ -117,6 +108,26 @@ public:
 			
 		}
 
+		int shift = GSupersampler::ShiftForSamples(paint.getSampleCount(), fDevice.width());
+		if (paint.isAntiAlias() && shift > 0) {
+			for (int i = 0; i < count; i++) {
+				pts[i] = pts[i] * (float)(1 << shift);
+			}
+			std::vector<GEdge> edges;
+			storeEdges(pts, count, edges);
+			fillSupersampled(edges, shift, paint);
+			return;
+		}
+
+		if (paint.isAntiAlias()) {
+			fCoverage.reset(fDevice.width(), fDevice.height());
+			for (int i = 0; i < count; i++) {
+				fCoverage.addLine(pts[i], pts[(i + 1) % count]);
+			}
+			fillCoverage(paint);
+			return;
+		}
+
 		std::vector<GEdge> edges;
 
 		// store edges
@@ -141,9 +152,9 @@ public:
 
 		int top = GRoundToInt(l.p_top.fY);
 		int bot = GRoundToInt(edges[edges.size() - 1].p_bottom.fY);
-		GPixel storage[fDevice.width()];
+		FanBlitter blitter(fDevice, paint, CTM_stack.top(), &fScratch);
 
-		for (int y = top; y < bot; ++y) {
+		for (int y = top; y < bot && y < fClipBottom; ++y) {
 			if (GRoundToInt(l.p_bottom.fY) <= y) {
 				l = edges[edge_count];
 				edge_count++;
@@ -155,8 +166,8 @@ public:
 			}
 
 			int x1, x2;
-			x1 = GRoundToInt(l.curr_x);
-			x2 = GRoundToInt(r.curr_x);
+			x1 = l.currentX();
+			x2 = r.currentX();
 
 			//if (paint.getShader()) {
 			//	// use the shader instead of the paint�s color
@@ -180,7 +191,9 @@ public:
 
 			//} else {
 			
-			blit(y, x1, x2, paint, storage);
+			if (y >= fClipTop) {
+				blitter.blitRow(y, x1, x2);
+			}
 			
 			/*}*/
 			
@@ -193,106 +206,60 @@ public:
 	}
 
 	void drawPath(const GPath& path, const GPaint& paint){
+		int shift = GSupersampler::ShiftForSamples(paint.getSampleCount(), fDevice.width());
+		if (paint.isAntiAlias() && shift > 0) {
+			GMatrix mat = CTM_stack.top();
+			mat.postScale(1 << shift, 1 << shift);
+			std::vector<GEdge> edges;
+			storeEdges(path, edges, mat);
+			fillSupersampled(edges, shift, paint);
+			return;
+		}
+
+		if (paint.isAntiAlias()) {
+			fCoverage.reset(fDevice.width(), fDevice.height());
+			flattenPath(path, CTM_stack.top(), [&](GPoint p0, GPoint p1) {
+				fCoverage.addLine(p0, p1);
+			});
+			fillCoverage(paint);
+			return;
+		}
+
 		std::vector<GEdge> edges;
 		storeEdges(path, edges, CTM_stack.top());
 
-		//std::cout << "sorted edges: " << std::endl;
-		//for (int i = 0; i < edges.size(); i++) {
-		//	//std::cout << "i: " << i << std::endl;
-		//	std::cout << edges[i].p_top.fX << "," << edges[i].p_top.fY << " " << edges[i].p_bottom.fX << "," << edges[i].p_bottom.fY << " curr_x : " << edges[i].curr_x <<" winding: "<<edges[i].winding<< std::endl;
-		//}
-
 		clipEdges(edges,fDevice.height(),fDevice.width());
 
-		//std::cout << "clipped edges: " << std::endl;
-		//for (int i = 0; i < edges.size(); i++) {
-		//	//std::cout << "i: " << i << std::endl;
-		//	std::cout << edges[i].p_top.fX << "," << edges[i].p_top.fY << " " << edges[i].p_bottom.fX << "," << edges[i].p_bottom.fY << " curr_x : " << edges[i].curr_x << " winding: " << edges[i].winding << std::endl;
-		//}
-
-		sortEdges(edges);
-
-		//std::cout << "sorted edges: " << std::endl;
-		//for (int i = 0; i < edges.size(); i++) {
-		//	//std::cout << "i: " << i << std::endl;
-		//	std::cout << edges[i].p_top.fX << "," << edges[i].p_top.fY << " " << edges[i].p_bottom.fX << "," << edges[i].p_bottom.fY << " curr_x : " << edges[i].curr_x << " winding: " << edges[i].winding << std::endl;
-		//}
-
-
 		//scan-converter
-		const GMatrix topCTM = CTM_stack.top();
-		GPath aPath = path;
-		aPath.transform(topCTM);
-
-		GRect bound = aPath.bounds();
-
-		int top = GRoundToInt(bound.fTop);
-		int bottom = GRoundToInt(bound.fBottom);
-		//std::vector<GEdge>::iterator next, edge;
-		int index, next=0;
-		GPixel storage[fDevice.width()];
-		GEdge* p = &edges.front();
-
-		for (int y = top; y < bottom; ) {
-			int size = edges.size();
-			int w= 0; //winding accumulator
-			int x0;
-			int x1;
-			index = 0;
-	
-			while (index<edges.size() && edges[index].y0 <= y && edges[index].y1 > y) {
-				
-				if (w == 0) {
-					x0 = GRoundToInt(edges[index].curr_x);
-				}
-
-				w += edges[index].winding;
+		FanBlitter blitter(fDevice, paint, CTM_stack.top(), &fScratch);
 
-				if (w == 0) {
-					
-					x1 = GRoundToInt(edges[index].curr_x);
-					blit(y, x0, x1, paint, storage);
-
-				}
-
-				next = index+1;
-				
-				
-				if (edges[index].y1 == y+1 ) {
-					edges.erase(edges.begin()+index);
-					next--;
-				}
-				else {
-					edges[index].updateCurrentX();
-					resort_backward(index,edges);
-				}
-
-				index = next;
-				
-			}
-
-			y++;
-
-			while (edges[index].y0 == y && index<edges.size()) {
-				next = index+1;
-
-				resort_backward(index,edges);
-
-				index = next;
-
-			}
-
-		}
+		walkEdges(edges, fClipTop, fClipBottom, [&](int y, int x0, int x1) {
+			blitter.blitRow(y, x0, x1);
+		});
 
 	}
 
 	void drawMesh(const GPoint verts[], const GColor colors[], const GPoint texs[], int count, 
 		const int indices[], const GPaint& paint) {
+		// texture coordinates need the paint's shader to sample
+		GShader* texture = texs ? paint.getShader() : nullptr;
+		if (!colors && !texture) {
+			return;
+		}
+
+		const GMatrix& ctm = CTM_stack.top();
+		FanMeshContext context(ctm, texture);
+		bool opaque = !texture || texture->isOpaque();
+		for (int i = 0; colors && opaque && i < 3 * count; ++i) {
+			opaque = colors[indices[i]].fA >= 1;
+		}
+		FanBlitter blitter(fDevice, &context, paint.getBlendMode(), opaque, &fScratch);
+
 		int n = 0;
 		GPoint points[3];
 		GColor color[3];
 		GPoint tex[3];
-		GPaint p = paint;
+		GPoint device[3];
 
 		for (int i = 0; i < count; ++i) {
 			points[0] = verts[indices[n]];
@@ -305,40 +272,34 @@ public:
 				color[2] = colors[indices[n + 2]];
 			}
 
-			if (texs != NULL) {
+			if (texture != NULL) {
 				tex[0] = texs[indices[n]];
 				tex[1] = texs[indices[n + 1]];
 				tex[2] = texs[indices[n + 2]];
 			}
+			n += 3;
 
-
-			if (colors != NULL && texs != NULL) {
-				TricolorShader s1(points, color);
-				ProxyShader s2(paint.getShader(), points, tex);
-				ComposeShader shader(&s1,&s2);
-				p.setShader(&shader);
-				drawConvexPolygon(points, 3, p);
-			}else if (colors != NULL) {
-				TricolorShader shader(points, color);
-				p.setShader(&shader);
-				drawConvexPolygon(points, 3, p);
-			}else if (texs != NULL) {
-
-				ProxyShader shader(paint.getShader(),points,tex);
-				p.setShader(&shader);
-				drawConvexPolygon(points, 3, p);
+			ctm.mapPoints(device, points, 3);
+			if (paint.isAntiAlias() || !fanTriangleInRange(device)) {
+				drawTriangle(points, colors ? color : nullptr, texture ? tex : nullptr, paint);
+				continue;
 			}
-
-			n += 3;
+			if (!context.setTriangle(points, colors ? color : nullptr, texture ? tex : nullptr)) {
+				continue;
+			}
+			fanWalkTriangle(device, fDevice.width(), fClipTop, fClipBottom, [&](int y, int x0, int x1) {
+				blitter.blitRow(y, x0, x1);
+			});
 		}
-
-			   		 
 	}
 
 	void drawQuad(const GPoint verts[4], const GColor colors[4], const GPoint texs[4], int level,
 		const GPaint& paint) {
-		GASSERT(level >= 0);
-
+		if (level < 0) {
+			GPoint device[4];
+			CTM_stack.top().mapPoints(device, verts, 4);
+			level = fanAutoQuadLevel(device, colors, paint.getShader() ? texs : nullptr);
+		}
 
 		if (level == 0) {
 			int indices[] = {0,1,3,2,1,3};
@@ -346,121 +307,229 @@ public:
 			return;
 		}
 
-		int count = (level + 2)*(level + 2);
-		int num = (level+1)*(level+1) * 6;
-		int indices[num];
-		GPoint v[count];
-		GPoint t[count];
-		GColor color[count];
-		
-
-		float U, V;
-
-		count = 0;
-		for (int i = 0; i < (level + 2); i++) {
-			U = ((float)i) / ((float)level + 1);
-			for (int j = 0; j < (level + 2); j++) {
-				V = ((float)j) / ((float)level + 1);
-				float a = (1 - U)*(1 - V);
-				float b = (1 - V)*U;
-				float c = (1 - U)*V;
-				float d = U * V;
-
-				v[count] = a*verts[0] + b*verts[1] + d*verts[2] + c*verts[3];
-
-				if (colors != NULL) {
-					color[count] = Cadd(Cadd(Cadd(Cmul(a, colors[0]), Cmul(b, colors[1])), Cmul(d, colors[2])), Cmul(c, colors[3]));
-				}
+		// (level + 2) x (level + 2) vertices, in buffers kept from one quad to the next
+		const int n = level + 2;
+		fQuadVerts.resize(n * n);
+		fanTessellateQuad(verts, n, fQuadVerts.data());
+		if (colors != NULL) {
+			fQuadColors.resize(n * n);
+			fanTessellateQuad(colors, n, fQuadColors.data());
+		}
+		if (texs != NULL) {
+			fQuadTexs.resize(n * n);
+			fanTessellateQuad(texs, n, fQuadTexs.data());
+		}
 
-				if (texs != NULL) {
-					t[count] = a * texs[0] + b * texs[1] + d * texs[2] + c * texs[3];
+		// two triangles per cell; they only depend on the level
+		if (fQuadIndexLevel != level) {
+			fQuadIndices.resize((n - 1) * (n - 1) * 6);
+			int k = 0;
+			for (int i = 0; i < n - 1; i++) {
+				for (int j = 0; j < n - 1; j++) {
+					int val = i * n + j;
+					fQuadIndices[k] = val;
+					fQuadIndices[k + 1] = val + 1;
+					fQuadIndices[k + 2] = val + n;
+					fQuadIndices[k + 3] = val + n + 1;
+					fQuadIndices[k + 4] = val + 1;
+					fQuadIndices[k + 5] = val + n;
+					k += 6;
 				}
-
-				count++;
 			}
+			fQuadIndexLevel = level;
 		}
-		GASSERT(count == (level+2)*(level+2));
-
 
-		int val,k = 0;
+		drawMesh(fQuadVerts.data(), colors ? fQuadColors.data() : nullptr,
+			texs ? fQuadTexs.data() : nullptr, (n - 1) * (n - 1) * 2, fQuadIndices.data(), paint);
+	}
 
-		for (int i = 0; i < (level + 1); i++) {
-			for (int j = 0; j < (level + 1); j++) {
-				val = i * (level + 2) + j;
-				indices[k] = val;
-				indices[k + 1] = val + 1;
-				indices[k + 2] = val + level + 2;
-				indices[k + 3] = val + level + 2 + 1;
-				indices[k + 4] = indices[k + 1];
-				indices[k + 5] = indices[k + 2];
-				k += 6;
-			}
+	// drawMesh, with the triangles' setup taken from the vertices: only the CTM is applied
+	// here, and each vertex is mapped once however many triangles share it.
+	void drawVertices(const GVertices& vertices, const GPaint& paint) override {
+		GShader* texture = vertices.texs() ? paint.getShader() : nullptr;
+		if (!vertices.colors() && !texture) {
+			return;
+		}
+		if (paint.isAntiAlias()) {
+			GCanvas::drawVertices(vertices, paint);
+			return;
 		}
 
-		GASSERT(k==num);
-
+		const GMatrix& ctm = CTM_stack.top();
+		FanMeshContext context(ctm, texture);
+		bool opaque = vertices.colorsAreOpaque() && (!texture || texture->isOpaque());
+		FanBlitter blitter(fDevice, &context, paint.getBlendMode(), opaque, &fScratch);
 
-		count = num / 3;
+		fMeshDevice.resize(vertices.vertexCount());
+		ctm.mapPoints(fMeshDevice.data(), vertices.positions(), vertices.vertexCount());
 
-		if (colors == NULL) {
-			drawMesh(v, nullptr, t, count, indices, paint);
-		}
-		else if (texs == NULL) {
-			drawMesh(v, color, nullptr, count, indices, paint);
-		}
-		else {
-			drawMesh(v, color, t, count, indices, paint);
+		const int* indices = vertices.indices();
+		const GVertices::ColorSetup* colorSetups = vertices.colorSetups();
+		const GMatrix* texMatrices = texture ? vertices.texMatrices() : nullptr;
+		for (int i = 0; i < vertices.triangleCount(); ++i) {
+			if (texMatrices && !vertices.texMatrixIsValid(i)) {
+				continue;
+			}
+			const int* tri = indices + 3 * i;
+			GPoint device[3] = { fMeshDevice[tri[0]], fMeshDevice[tri[1]], fMeshDevice[tri[2]] };
+			if (!fanTriangleInRange(device)) {
+				this->drawVerticesTriangle(vertices, tri, texture != nullptr, paint);
+				continue;
+			}
+			if (!context.setTriangle(colorSetups ? &colorSetups[i] : nullptr,
+				texMatrices ? &texMatrices[i] : nullptr)) {
+				continue;
+			}
+			fanWalkTriangle(device, fDevice.width(), fClipTop, fClipBottom, [&](int y, int x0, int x1) {
+				blitter.blitRow(y, x0, x1);
+			});
 		}
-		
 	}
 
 	
 private:
 	const GBitmap fDevice;
 
-	void blit(int y, int x1, int x2, const GPaint& paint, GPixel* storage) {
+	// One triangle of a mesh through drawConvexPolygon, with a shader built for it; for what
+	// the mesh rasterizer does not draw itself (anti-aliasing, and triangles too far out for
+	// its integer edges). colors and texs may be null, but not both.
+	void drawTriangle(const GPoint points[3], const GColor colors[3], const GPoint texs[3],
+		const GPaint& paint) {
+		GPaint p = paint;
+		if (colors != NULL && texs != NULL) {
+			TricolorShader s1(points, colors);
+			ProxyShader s2(paint.getShader(), points, texs);
+			ComposeShader shader(&s1, &s2);
+			p.setShader(&shader);
+			drawConvexPolygon(points, 3, p);
+		} else if (colors != NULL) {
+			TricolorShader shader(points, colors);
+			p.setShader(&shader);
+			drawConvexPolygon(points, 3, p);
+		} else {
+			ProxyShader shader(paint.getShader(), points, texs);
+			p.setShader(&shader);
+			drawConvexPolygon(points, 3, p);
+		}
+	}
 
-		int mode = static_cast<int>(paint.getBlendMode());
-		
-		//std::cout << "y: " << y << " x1: "<<x1<<" x2: "<<x2<< std::endl;
+	// drawTriangle for the triangle of vertices whose indices are tri
+	void drawVerticesTriangle(const GVertices& vertices, const int tri[3], bool textured,
+		const GPaint& paint) {
+		GPoint points[3];
+		GColor colors[3];
+		GPoint texs[3];
+		for (int k = 0; k < 3; ++k) {
+			points[k] = vertices.positions()[tri[k]];
+			if (vertices.colors()) {
+				colors[k] = vertices.colors()[tri[k]];
+			}
+			if (textured) {
+				texs[k] = vertices.texs()[tri[k]];
+			}
+		}
+		drawTriangle(points, vertices.colors() ? colors : nullptr, textured ? texs : nullptr, paint);
+	}
 
-		if (paint.getShader()) {
+	// Fills the rect directly when the CTM only scales and translates, so it stays axis-aligned.
+	// The bounds are rounded the way the edge walker rounds vertical edges, so the pixels match
+	// drawConvexPolygon exactly. Returns false if the rect needs the general path.
+	bool drawAlignedRect(const GRect& rect, const GPaint& paint) {
+		const GMatrix& ctm = CTM_stack.top();
+		if (ctm[GMatrix::KX] != 0 || ctm[GMatrix::KY] != 0) {
+			return false;
+		}
 
-			if (!paint.getShader()->setContext(CTM_stack.top())) {
-				return;
-			}
+		GPoint src[2] = { GPoint::Make(rect.fLeft, rect.fTop), GPoint::Make(rect.fRight, rect.fBottom) };
+		GPoint dst[2];
+		ctm.mapPoints(dst, src, 2);
 
-			paint.getShader()->setContext(CTM_stack.top());
+		float l = std::min(dst[0].fX, dst[1].fX);
+		float r = std::max(dst[0].fX, dst[1].fX);
+		float t = std::min(dst[0].fY, dst[1].fY);
+		float b = std::max(dst[0].fY, dst[1].fY);
+		if (!(l == l && r == r && t == t && b == b)) {
+			return false;
+		}
 
-			GShader* shader = paint.getShader();
+		// anti-aliasing only changes the edges of rects that do not land on pixel boundaries
+		if (paint.isAntiAlias() &&
+			(l != floorf(l) || r != floorf(r) || t != floorf(t) || b != floorf(b))) {
+			return false;
+		}
 
+		int x0 = std::max(0, std::min(fDevice.width(), GFixedRoundToInt(GFloatToFixed(l))));
+		int x1 = std::max(0, std::min(fDevice.width(), GFixedRoundToInt(GFloatToFixed(r))));
+		int y0 = std::max(fClipTop, GRoundToInt(std::max(-1.0f, t)));
+		int y1 = std::min(fClipBottom, GRoundToInt(std::min((float)fDevice.height() + 1, b)));
+		if (x0 >= x1 || y0 >= y1) {
+			return true;
+		}
 
-			shader->shadeRow(x1, y, x2 - x1, storage);
+		FanBlitter blitter(fDevice, paint, ctm, &fScratch);
+		for (int y = y0; y < y1; ++y) {
+			blitter.blitRow(y, x0, x1);
+		}
+		return true;
+	}
 
-			GPixel* row = fDevice.getAddr(0, y);
+	// blends the paint into every pixel in proportion to the coverage accumulated in fCoverage
+	void fillCoverage(const GPaint& paint) {
+		FanBlitter blitter(fDevice, paint, CTM_stack.top(), &fScratch);
 
-			for (int x = x1; x < x2; ++x) {
-				row[x] = (*BlendProc[mode])(storage[x-x1], row[x]);
+		fCoverage.resolve(fClipTop, fClipBottom, [&](int y, int x, int count, const uint8_t cov[]) {
+			blitter.blitCoverage(y, x, count, cov);
+		});
+	}
 
-			}
+	// edges are in supersampled device space (scaled by 1 << shift)
+	void fillSupersampled(std::vector<GEdge>& edges, int shift, const GPaint& paint) {
+		FanBlitter blitter(fDevice, paint, CTM_stack.top(), &fScratch);
 
-		}
-		else {
-			GPixel source = color_to_pixel(paint.getColor());
-			GPixel* row = fDevice.getAddr(0, y);
-			for (int x = x1; x < x2; ++x) {
-				row[x] = (*BlendProc[mode])(source, row[x]);
-			}
-		}	
+		clipEdges(edges, fDevice.height() << shift, fDevice.width() << shift);
+		fSupersampler.fill(edges, fDevice.width(), fClipTop, fClipBottom, shift,
+			[&](int y, int x, int count, const uint8_t cov[]) {
+			blitter.blitCoverage(y, x, count, cov);
+		});
 	}
 
 	std::stack<GMatrix> CTM_stack;
+	int fClipTop;
+	int fClipBottom;
+	GCoverage fCoverage;
+	GSupersampler fSupersampler;
+	// rows for shaders' colors, shared by every draw (see FanBlitter)
+	GShader::Scratch fScratch;
+	// drawQuad's tessellation
+	std::vector<GPoint> fQuadVerts;
+	std::vector<GColor> fQuadColors;
+	std::vector<GPoint> fQuadTexs;
+	std::vector<int> fQuadIndices;
+	int fQuadIndexLevel;
+	// drawVertices' vertices, mapped to the device
+	std::vector<GPoint> fMeshDevice;
 
 };
 
+#include "FanTiledCanvas.h"
+
+bool GPaint::isOpaque() const {
+	if (fShader) {
+		return fShader->isOpaque();
+	}
+	return fColor.fA >= 1;
+}
+
 std::unique_ptr<GCanvas> GCreateCanvas(const GBitmap& device) {
 	if (!device.pixels()) {
 		return nullptr;
 	}
 	return std::unique_ptr<GCanvas>(new FanCanvas(device));
-}
\ No newline at end of file
+}
+
+std::unique_ptr<GCanvas> GCreateCanvas(const GBitmap& device, int threads) {
+	if (!device.pixels() || threads < 1) {
+		return nullptr;
+	}
+	return std::unique_ptr<GCanvas>(new FanTiledCanvas(device, threads));
+}
@@ -0,0 +1,159 @@
+#include "include/GCpu.h"
+#include "FanBlitRow.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+struct SSE2Ops {
+	typedef __m128i V;
+	enum { kPixels = 4 };
+
+	static V load(const GPixel* p) { return _mm_loadu_si128((const __m128i*)p); }
+	static void store(GPixel* p, V v) { _mm_storeu_si128((__m128i*)p, v); }
+	static V splat(GPixel p) { return _mm_set1_epi32((int)p); }
+	static V splat16(int x) { return _mm_set1_epi16((short)x); }
+	static V splat64(uint64_t x) { return _mm_set1_epi64x((long long)x); }
+	static V lo(V v) { return _mm_unpacklo_epi8(v, _mm_setzero_si128()); }
+	static V hi(V v) { return _mm_unpackhi_epi8(v, _mm_setzero_si128()); }
+	static V pack(V lo, V hi) { return _mm_packus_epi16(lo, hi); }
+	static V add(V a, V b) { return _mm_add_epi16(a, b); }
+	static V sub(V a, V b) { return _mm_sub_epi16(a, b); }
+	static V mul(V a, V b) { return _mm_mullo_epi16(a, b); }
+	static V shr8(V a) { return _mm_srli_epi16(a, 8); }
+	static V bitAnd(V a, V b) { return _mm_and_si128(a, b); }
+	static V bitAndNot(V a, V b) { return _mm_andnot_si128(a, b); }
+	static V bitOr(V a, V b) { return _mm_or_si128(a, b); }
+	static V alpha(V a) {
+		a = _mm_shufflelo_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+		return _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+	static V swapRB(V a) {
+		a = _mm_shufflelo_epi16(a, _MM_SHUFFLE(3, 0, 1, 2));
+		return _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 0, 1, 2));
+	}
+};
+#endif
+
+// in FanCpu_avx2.cpp and FanCpu_avx512.cpp, built for those targets
+void FanCpuFill_AVX2(GCpuProcs* procs);
+void FanCpuFill_AVX512(GCpuProcs* procs);
+
+static BlendRowProcType gSrcOverRow;
+
+static void blend_row_clear(GPixel src, GPixel dst[], int count) {
+	std::fill_n(dst, count, 0);
+}
+
+static void blend_row_src(GPixel src, GPixel dst[], int count) {
+	std::fill_n(dst, count, src);
+}
+
+static void blend_row_dst(GPixel src, GPixel dst[], int count) {}
+
+static void blend_row_srcover(GPixel src, GPixel dst[], int count) {
+	switch (GPixel_GetA(src)) {
+		case 0:
+			return;
+		case 255:
+			std::fill_n(dst, count, src);
+			return;
+		default:
+			gSrcOverRow(src, dst, count);
+	}
+}
+
+static void FillScalarProcs(GCpuProcs* procs) {
+	procs->blendRow[(int)GBlendMode::kSrcOver]  = blend_row_scalar<(int)GBlendMode::kSrcOver>;
+	procs->blendRow[(int)GBlendMode::kDstOver]  = blend_row_scalar<(int)GBlendMode::kDstOver>;
+	procs->blendRow[(int)GBlendMode::kSrcIn]    = blend_row_scalar<(int)GBlendMode::kSrcIn>;
+	procs->blendRow[(int)GBlendMode::kDstIn]    = blend_row_scalar<(int)GBlendMode::kDstIn>;
+	procs->blendRow[(int)GBlendMode::kSrcOut]   = blend_row_scalar<(int)GBlendMode::kSrcOut>;
+	procs->blendRow[(int)GBlendMode::kDstOut]   = blend_row_scalar<(int)GBlendMode::kDstOut>;
+	procs->blendRow[(int)GBlendMode::kSrcATop]  = blend_row_scalar<(int)GBlendMode::kSrcATop>;
+	procs->blendRow[(int)GBlendMode::kDstATop]  = blend_row_scalar<(int)GBlendMode::kDstATop>;
+	procs->blendRow[(int)GBlendMode::kXor]      = blend_row_scalar<(int)GBlendMode::kXor>;
+	procs->premulRGBA = premul_rgba_scalar;
+}
+
+static GCpuLevel DetectLevel() {
+	GCpuLevel level = GCpuLevel::kScalar;
+#if defined(__SSE2__)
+	level = GCpuLevel::kSSE2;
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		level = GCpuLevel::kAVX2;
+	}
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+		level = GCpuLevel::kAVX512;
+	}
+#endif
+
+	// a lower level can be forced for testing and benchmarking
+	if (const char* forced = getenv("G_CPU_LEVEL")) {
+		for (int i = (int)GCpuLevel::kScalar; i <= (int)level; ++i) {
+			if (!strcmp(forced, GCpuLevelName((GCpuLevel)i))) {
+				return (GCpuLevel)i;
+			}
+		}
+		fprintf(stderr, "G_CPU_LEVEL=%s is not available, using %s\n", forced, GCpuLevelName(level));
+	}
+	return level;
+}
+
+static GCpuProcs MakeProcs(GCpuLevel level) {
+	GCpuProcs procs;
+	FillScalarProcs(&procs);
+
+	switch (level) {
+		case GCpuLevel::kScalar:
+			break;
+#if defined(__SSE2__)
+		case GCpuLevel::kSSE2:
+			FillBlendRowProcs<SSE2Ops>(procs.blendRow);
+			procs.premulRGBA = premul_rgba_vector<SSE2Ops>;
+			break;
+		case GCpuLevel::kAVX2:
+			FanCpuFill_AVX2(&procs);
+			break;
+		case GCpuLevel::kAVX512:
+			FanCpuFill_AVX512(&procs);
+			break;
+#else
+		default:
+			break;
+#endif
+	}
+
+	gSrcOverRow = procs.blendRow[(int)GBlendMode::kSrcOver];
+	procs.blendRow[(int)GBlendMode::kClear] = blend_row_clear;
+	procs.blendRow[(int)GBlendMode::kSrc] = blend_row_src;
+	procs.blendRow[(int)GBlendMode::kDst] = blend_row_dst;
+	procs.blendRow[(int)GBlendMode::kSrcOver] = blend_row_srcover;
+	return procs;
+}
+
+GCpuLevel GGetCpuLevel() {
+	static const GCpuLevel level = DetectLevel();
+	return level;
+}
+
+const char* GCpuLevelName(GCpuLevel level) {
+	switch (level) {
+		case GCpuLevel::kScalar:  return "scalar";
+		case GCpuLevel::kSSE2:    return "sse2";
+		case GCpuLevel::kAVX2:    return "avx2";
+		case GCpuLevel::kAVX512:  return "avx512";
+	}
+	return "unknown";
+}
+
+const GCpuProcs& GCpu() {
+	static const GCpuProcs procs = MakeProcs(GGetCpuLevel());
+	return procs;
+}
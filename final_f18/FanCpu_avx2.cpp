@@ -0,0 +1,60 @@
+// The AVX2 kernels. Everything in this file is compiled for AVX2 and only runs once GCpu() has
+// checked that the CPU supports it.
+
+#include "include/GCpu.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Everything shared with other files comes in before the pragma: their inline functions (GPoint,
+// GColor, ...) are merged across files by the linker, and a copy built for this target could
+// end up called on a CPU without it. What FanBlitRow.h itself defines is static, so it is safe
+// to build here.
+#include <immintrin.h>
+#include "include/GBlendMode.h"
+#include "include/GPixel.h"
+#include "Utils.h"
+#include "FanBlendMode.h"
+
+#pragma GCC target("avx2")
+
+#include "FanBlitRow.h"
+
+struct AVX2Ops {
+	typedef __m256i V;
+	enum { kPixels = 8 };
+
+	static V load(const GPixel* p) { return _mm256_loadu_si256((const __m256i*)p); }
+	static void store(GPixel* p, V v) { _mm256_storeu_si256((__m256i*)p, v); }
+	static V splat(GPixel p) { return _mm256_set1_epi32((int)p); }
+	static V splat16(int x) { return _mm256_set1_epi16((short)x); }
+	static V splat64(uint64_t x) { return _mm256_set1_epi64x((long long)x); }
+	static V lo(V v) { return _mm256_unpacklo_epi8(v, _mm256_setzero_si256()); }
+	static V hi(V v) { return _mm256_unpackhi_epi8(v, _mm256_setzero_si256()); }
+	static V pack(V lo, V hi) { return _mm256_packus_epi16(lo, hi); }
+	static V add(V a, V b) { return _mm256_add_epi16(a, b); }
+	static V sub(V a, V b) { return _mm256_sub_epi16(a, b); }
+	static V mul(V a, V b) { return _mm256_mullo_epi16(a, b); }
+	static V shr8(V a) { return _mm256_srli_epi16(a, 8); }
+	static V bitAnd(V a, V b) { return _mm256_and_si256(a, b); }
+	static V bitAndNot(V a, V b) { return _mm256_andnot_si256(a, b); }
+	static V bitOr(V a, V b) { return _mm256_or_si256(a, b); }
+	static V alpha(V a) {
+		a = _mm256_shufflelo_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+		return _mm256_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+	static V swapRB(V a) {
+		a = _mm256_shufflelo_epi16(a, _MM_SHUFFLE(3, 0, 1, 2));
+		return _mm256_shufflehi_epi16(a, _MM_SHUFFLE(3, 0, 1, 2));
+	}
+};
+
+void FanCpuFill_AVX2(GCpuProcs* procs) {
+	FillBlendRowProcs<AVX2Ops>(procs->blendRow);
+	procs->premulRGBA = premul_rgba_vector<AVX2Ops>;
+}
+
+#else
+
+void FanCpuFill_AVX2(GCpuProcs* procs) {}
+
+#endif
@@ -0,0 +1,60 @@
+// The AVX-512 kernels (F + BW, for the 16-bit lane operations). Everything in this file is
+// compiled for AVX-512 and only runs once GCpu() has checked that the CPU supports it.
+
+#include "include/GCpu.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Everything shared with other files comes in before the pragma: their inline functions (GPoint,
+// GColor, ...) are merged across files by the linker, and a copy built for this target could
+// end up called on a CPU without it. What FanBlitRow.h itself defines is static, so it is safe
+// to build here.
+#include <immintrin.h>
+#include "include/GBlendMode.h"
+#include "include/GPixel.h"
+#include "Utils.h"
+#include "FanBlendMode.h"
+
+#pragma GCC target("avx512f,avx512bw")
+
+#include "FanBlitRow.h"
+
+struct AVX512Ops {
+	typedef __m512i V;
+	enum { kPixels = 16 };
+
+	static V load(const GPixel* p) { return _mm512_loadu_si512((const void*)p); }
+	static void store(GPixel* p, V v) { _mm512_storeu_si512((void*)p, v); }
+	static V splat(GPixel p) { return _mm512_set1_epi32((int)p); }
+	static V splat16(int x) { return _mm512_set1_epi16((short)x); }
+	static V splat64(uint64_t x) { return _mm512_set1_epi64((long long)x); }
+	static V lo(V v) { return _mm512_unpacklo_epi8(v, _mm512_setzero_si512()); }
+	static V hi(V v) { return _mm512_unpackhi_epi8(v, _mm512_setzero_si512()); }
+	static V pack(V lo, V hi) { return _mm512_packus_epi16(lo, hi); }
+	static V add(V a, V b) { return _mm512_add_epi16(a, b); }
+	static V sub(V a, V b) { return _mm512_sub_epi16(a, b); }
+	static V mul(V a, V b) { return _mm512_mullo_epi16(a, b); }
+	static V shr8(V a) { return _mm512_srli_epi16(a, 8); }
+	static V bitAnd(V a, V b) { return _mm512_and_si512(a, b); }
+	static V bitAndNot(V a, V b) { return _mm512_andnot_si512(a, b); }
+	static V bitOr(V a, V b) { return _mm512_or_si512(a, b); }
+	static V alpha(V a) {
+		a = _mm512_shufflelo_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+		return _mm512_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+	static V swapRB(V a) {
+		a = _mm512_shufflelo_epi16(a, _MM_SHUFFLE(3, 0, 1, 2));
+		return _mm512_shufflehi_epi16(a, _MM_SHUFFLE(3, 0, 1, 2));
+	}
+};
+
+void FanCpuFill_AVX512(GCpuProcs* procs) {
+	FillBlendRowProcs<AVX512Ops>(procs->blendRow);
+	procs->premulRGBA = premul_rgba_vector<AVX512Ops>;
+}
+
+#else
+
+void FanCpuFill_AVX512(GCpuProcs* procs) {}
+
+#endif
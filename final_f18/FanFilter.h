@@ -0,0 +1,145 @@
+#ifndef FanFilter_DEFINED
+#define FanFilter_DEFINED
+
+#include "include/GBitmap.h"
+#include "include/GMath.h"
+#include "include/GPixel.h"
+#include "ShadeMode.h"
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Filtered sampling for the bitmap shader. A sample at (fx, fy), in texels with pixel centers at
+// +0.5, blends an N x N block of texels: N = 2 is bilinear, N = 4 is bicubic (the
+// Mitchell-Netravali filter, B = C = 1/3). Taps are found and weighted one axis at a time by
+// filter_taps, so a row that keeps y (or x) fixed can compute that axis once.
+//
+// Each tap is one 4-lane multiply-add of the whole pixel: SSE floats when the target has them,
+// a float[4] otherwise. Both round the same way, so they give the same pixels.
+
+#if defined(__SSE2__)
+typedef __m128 Fan4f;
+
+static inline Fan4f fan4f_zero() {
+	return _mm_setzero_ps();
+}
+
+static inline Fan4f fan4f_load(GPixel p) {
+	__m128i v = _mm_cvtsi32_si128((int)p);
+	v = _mm_unpacklo_epi8(v, _mm_setzero_si128());
+	v = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+	return _mm_cvtepi32_ps(v);
+}
+
+// acc + v * w
+static inline Fan4f fan4f_mad(Fan4f acc, Fan4f v, float w) {
+	return _mm_add_ps(acc, _mm_mul_ps(v, _mm_set1_ps(w)));
+}
+
+// Negative lobes can push a component below 0 or above its alpha; both are pinned so the
+// result is still premultiplied.
+static inline GPixel fan4f_store(Fan4f v) {
+	const int a = GPIXEL_SHIFT_A / 8;
+	Fan4f alpha = _mm_shuffle_ps(v, v, _MM_SHUFFLE(a, a, a, a));
+	v = _mm_max_ps(_mm_min_ps(v, alpha), _mm_setzero_ps());
+	__m128i i = _mm_cvttps_epi32(_mm_add_ps(v, _mm_set1_ps(0.5f)));
+	i = _mm_packs_epi32(i, i);
+	return (GPixel)_mm_cvtsi128_si32(_mm_packus_epi16(i, i));
+}
+#else
+struct Fan4f {
+	float v[4];
+};
+
+static inline Fan4f fan4f_zero() {
+	return { { 0, 0, 0, 0 } };
+}
+
+static inline Fan4f fan4f_load(GPixel p) {
+	return { { (float)(p & 0xFF), (float)((p >> 8) & 0xFF), (float)((p >> 16) & 0xFF),
+			   (float)(p >> 24) } };
+}
+
+static inline Fan4f fan4f_mad(Fan4f acc, Fan4f v, float w) {
+	for (int i = 0; i < 4; ++i) {
+		acc.v[i] += v.v[i] * w;
+	}
+	return acc;
+}
+
+static inline GPixel fan4f_store(Fan4f v) {
+	const float alpha = std::min(v.v[GPIXEL_SHIFT_A / 8], 255.0f);
+	GPixel p = 0;
+	for (int i = 0; i < 4; ++i) {
+		p |= (GPixel)(std::max(std::min(v.v[i], alpha), 0.0f) + 0.5f) << (8 * i);
+	}
+	return p;
+}
+#endif
+
+// Mitchell-Netravali, B = C = 1/3, at distance x in [0, 2)
+static inline float mitchell(float x) {
+	const float B = 1.0f / 3, C = 1.0f / 3;
+	if (x < 1) {
+		return ((12 - 9 * B - 6 * C) * x * x * x + (-18 + 12 * B + 6 * C) * x * x + (6 - 2 * B)) / 6;
+	}
+	return ((-B - 6 * C) * x * x * x + (6 * B + 30 * C) * x * x + (-12 * B - 48 * C) * x +
+			(8 * B + 24 * C)) / 6;
+}
+
+// The first (untiled) tap of an N-tap filter at f, and the taps' weights.
+template <int N>
+static inline int filter_weights(float f, float w[N]) {
+	// keeps the index well inside an int; samples that far out are all edge (or tiled) texels
+	f = std::max(-1.0e8f, std::min(1.0e8f, f)) - 0.5f;
+	int i0 = GFloorToInt(f);
+	float t = f - i0;
+	if (N == 2) {
+		w[0] = 1 - t;
+		w[1] = t;
+		return i0;
+	}
+	w[0] = mitchell(t + 1);
+	w[1] = mitchell(t);
+	w[2] = mitchell(1 - t);
+	w[3] = mitchell(2 - t);
+	return i0 - 1;
+}
+
+// Tiles the N indices starting at i0 into [0, n); only taps that reach past an edge need it.
+template <int N, int Mode>
+static inline void filter_index(int i0, int n, int index[N]) {
+	if (i0 >= 0 && i0 <= n - N) {
+		for (int k = 0; k < N; ++k) {
+			index[k] = i0 + k;
+		}
+		return;
+	}
+	for (int k = 0; k < N; ++k) {
+		index[k] = tile_index<Mode, false>(i0 + k, n);
+	}
+}
+
+// Tiled tap indices (in [0, n)) and weights along one axis.
+template <int N, int Mode>
+static inline void filter_taps(float f, int n, int index[N], float w[N]) {
+	filter_index<N, Mode>(filter_weights<N>(f, w), n, index);
+}
+
+// Blends the N x N texels at rows[j][xs[i]] with weights wx[i] * wy[j].
+template <int N>
+static inline GPixel filter_sample(const GPixel* const rows[N], const int xs[N], const float wx[N],
+	const float wy[N]) {
+	Fan4f acc = fan4f_zero();
+	for (int j = 0; j < N; ++j) {
+		Fan4f line = fan4f_zero();
+		for (int i = 0; i < N; ++i) {
+			line = fan4f_mad(line, fan4f_load(rows[j][xs[i]]), wx[i]);
+		}
+		acc = fan4f_mad(acc, line, wy[j]);
+	}
+	return fan4f_store(acc);
+}
+
+#endif
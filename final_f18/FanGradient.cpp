@@ -0,0 +1,54 @@
+#include "FanGradient.h"
+#include "include/GMath.h"
+#include "Utils.h"
+#include <map>
+#include <mutex>
+
+FanGradientLUT::FanGradientLUT(const GColor colors[], int count) {
+	const int intervals = count - 1;
+
+	for (int i = 0; i < kCount; ++i) {
+		float t = (float)i / (kCount - 1);
+
+		int left = GFloorToInt(t * intervals);
+		int right = GCeilToInt(t * intervals);
+
+		float u = t * intervals - left;
+		float v = 1 - u;
+
+		float a = v * colors[left].fA + u * colors[right].fA;
+		float r = v * colors[left].fR + u * colors[right].fR;
+		float g = v * colors[left].fG + u * colors[right].fG;
+		float b = v * colors[left].fB + u * colors[right].fB;
+
+		fPixels[i] = color_to_pixel(GColor::MakeARGB(a, r, g, b));
+	}
+}
+
+std::shared_ptr<const FanGradientLUT> FanGradientLUT::Find(const GColor colors[], int count) {
+	// keyed by the stops' components; entries go away with the last shader that uses them
+	typedef std::map<std::vector<float>, std::weak_ptr<const FanGradientLUT>> Cache;
+	static std::mutex gMutex;
+	static Cache gCache;
+
+	std::vector<float> key;
+	for (int i = 0; i < count; ++i) {
+		key.insert(key.end(), { colors[i].fA, colors[i].fR, colors[i].fG, colors[i].fB });
+	}
+
+	std::lock_guard<std::mutex> lock(gMutex);
+	std::weak_ptr<const FanGradientLUT>& entry = gCache[key];
+	std::shared_ptr<const FanGradientLUT> lut = entry.lock();
+	if (!lut) {
+		for (Cache::iterator it = gCache.begin(); it != gCache.end();) {
+			if (it->second.expired() && &it->second != &entry) {
+				it = gCache.erase(it);
+			} else {
+				++it;
+			}
+		}
+		lut.reset(new FanGradientLUT(colors, count));
+		entry = lut;
+	}
+	return lut;
+}
@@ -0,0 +1,32 @@
+#ifndef FanGradient_DEFINED
+#define FanGradient_DEFINED
+
+#include "include/GColor.h"
+#include "include/GPixel.h"
+#include <memory>
+#include <vector>
+
+// A gradient's colors, interpolated between its stops and premultiplied, at kCount evenly spaced
+// positions in [0, 1]. The gradient shaders tile a position and look it up rather than
+// interpolating the stops for every pixel.
+//
+// Tables are shared: Find() returns the table that is already in use for the same stops, if
+// there is one, and builds it otherwise. It can be called from any thread.
+class FanGradientLUT {
+public:
+	enum { kCount = 1024 };
+
+	static std::shared_ptr<const FanGradientLUT> Find(const GColor colors[], int count);
+
+	// t must be in [0, 1]
+	GPixel lookup(float t) const {
+		return fPixels[(int)(t * (kCount - 1) + 0.5f)];
+	}
+
+private:
+	FanGradientLUT(const GColor colors[], int count);
+
+	GPixel fPixels[kCount];
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "FanImage.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+FanImage::FanImage(const GBitmap& bitmap) {
+	fLevels.push_back(bitmap);
+}
+
+std::shared_ptr<FanImage> FanImage::Find(const GBitmap& bitmap) {
+	typedef std::map<uint32_t, std::weak_ptr<FanImage>> Cache;
+	static std::mutex gMutex;
+	static Cache gCache;
+
+	std::lock_guard<std::mutex> lock(gMutex);
+	std::weak_ptr<FanImage>& entry = gCache[bitmap.getGenerationID()];
+	std::shared_ptr<FanImage> image = entry.lock();
+	if (!image) {
+		for (Cache::iterator it = gCache.begin(); it != gCache.end();) {
+			if (it->second.expired() && &it->second != &entry) {
+				it = gCache.erase(it);
+			} else {
+				++it;
+			}
+		}
+		image.reset(new FanImage(bitmap));
+		entry = image;
+	}
+	return image;
+}
+
+int FanImage::LevelForScale(float texelsPerPixel) {
+	if (!(texelsPerPixel >= 2)) {
+		return 0;
+	}
+	return std::min(30, (int)std::log2(texelsPerPixel));
+}
+
+// the average of each 2x2 block of src (the last row or column repeats if src's size is odd)
+static void Downsample(const GBitmap& src, const GBitmap& dst) {
+	for (int y = 0; y < dst.height(); ++y) {
+		const GPixel* row0 = src.getAddr(0, 2 * y);
+		const GPixel* row1 = src.getAddr(0, std::min(2 * y + 1, src.height() - 1));
+		GPixel* out = dst.getAddr(0, y);
+		for (int x = 0; x < dst.width(); ++x) {
+			int x0 = 2 * x;
+			int x1 = std::min(x0 + 1, src.width() - 1);
+			GPixel p[4] = { row0[x0], row0[x1], row1[x0], row1[x1] };
+			unsigned c[4] = { 0, 0, 0, 0 };
+			for (int i = 0; i < 4; ++i) {
+				for (int k = 0; k < 4; ++k) {
+					c[k] += (p[i] >> (8 * k)) & 0xFF;
+				}
+			}
+			out[x] = ((c[0] + 2) >> 2) | (((c[1] + 2) >> 2) << 8) | (((c[2] + 2) >> 2) << 16) |
+					 (((c[3] + 2) >> 2) << 24);
+		}
+	}
+}
+
+GBitmap FanImage::level(int index) {
+	std::lock_guard<std::mutex> lock(fMutex);
+	while ((int)fLevels.size() <= index) {
+		const GBitmap& prev = fLevels.back();
+		if (prev.width() == 1 && prev.height() == 1) {
+			break;
+		}
+		int w = (prev.width() + 1) / 2;
+		int h = (prev.height() + 1) / 2;
+		fStorage.emplace_back(new GPixel[w * h]);
+		GBitmap next(w, h, w * sizeof(GPixel), fStorage.back().get(), false);
+		Downsample(prev, next);
+		fLevels.push_back(next);
+	}
+	return fLevels[std::min(index, (int)fLevels.size() - 1)];
+}
+
+bool FanImage::IsOpaque(const GBitmap& bitmap) {
+	if (bitmap.isOpaque()) {
+		return true;
+	}
+	// one answer per slot, stamped with the ID it is for (0, no pixels, is never stored)
+	struct Entry {
+		uint32_t fGenerationID;
+		bool fOpaque;
+	};
+	static std::mutex gMutex;
+	static Entry gEntries[64];
+
+	const uint32_t id = bitmap.getGenerationID();
+	Entry& entry = gEntries[id % 64];
+	{
+		std::lock_guard<std::mutex> lock(gMutex);
+		if (id != 0 && entry.fGenerationID == id) {
+			return entry.fOpaque;
+		}
+	}
+	GBitmap copy = bitmap;
+	copy.computeIsOpaque();
+	if (id != 0) {
+		std::lock_guard<std::mutex> lock(gMutex);
+		entry = { id, copy.isOpaque() };
+	}
+	return copy.isOpaque();
+}
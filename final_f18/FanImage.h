@@ -0,0 +1,42 @@
+#ifndef FanImage_DEFINED
+#define FanImage_DEFINED
+
+#include "include/GBitmap.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// What the bitmap shader derives from a bitmap's pixels, computed the first time a draw needs
+// it and then kept: mip levels, successively halved copies for drawing it minified. Level 0 is
+// the bitmap itself; each next level is half the size of the one before (rounded up), each of
+// its pixels the average of 2x2 pixels there, down to 1x1.
+//
+// Images are shared: Find() returns the one already in use for the bitmap's generation ID, so
+// every shader of the same pixels (and every draw with them) computes these once. Editing the
+// pixels and calling GBitmap::notifyPixelsChanged() gives later shaders a new image; shaders
+// made before keep the old one.
+class FanImage {
+public:
+	static std::shared_ptr<FanImage> Find(const GBitmap& bitmap);
+
+	// The level for a draw that steps over this many level-0 pixels per device pixel: the
+	// largest one whose pixels are still no bigger than a device pixel.
+	static int LevelForScale(float texelsPerPixel);
+
+	// Whether every pixel is opaque: the bitmap's flag, or else its pixels, looked at once per
+	// generation ID. The answers for recent IDs outlive the images, so a bitmap that gets a new
+	// shader every draw is not looked at again. Can be called from any thread.
+	static bool IsOpaque(const GBitmap& bitmap);
+
+	// index is clamped to the levels the bitmap has. Can be called from any thread.
+	GBitmap level(int index);
+
+private:
+	explicit FanImage(const GBitmap& bitmap);
+
+	std::mutex fMutex;
+	std::vector<GBitmap> fLevels;
+	std::vector<std::unique_ptr<GPixel[]>> fStorage;
+};
+
+#endif
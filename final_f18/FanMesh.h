@@ -0,0 +1,355 @@
+#ifndef FanMesh_DEFINED
+#define FanMesh_DEFINED
+
+#include "include/GMatrix.h"
+#include "include/GShader.h"
+#include "include/GVertices.h"
+#include "Utils.h"
+#include <algorithm>
+
+// The triangles of drawMesh, drawn without building shaders for each one. A single
+// FanMeshContext lives for the whole mesh and is pointed at one triangle after another: it
+// interpolates the vertex colors itself, stepping them along each span, and samples the
+// paint's shader through one context, pointed at each triangle's texture mapping in turn.
+//
+// fanWalkTriangle covers a pixel when its center is inside the triangle. Centers that land
+// exactly on an edge are settled with the top-left rule: they belong to the triangle if the
+// edge is a left edge or a horizontal top edge. The vertices are snapped to 1/256 of a pixel
+// and the edges evaluated exactly in integers, so triangles that share an edge or a vertex
+// always agree on which side of it a center is. Each pixel of a mesh is then covered once: no
+// seams between triangles and no pixels blended twice.
+
+// Device coordinates a triangle may reach and still be walked here, so that the products of
+// snapped coordinates fit in 64 bits. Triangles that reach past it go through
+// drawConvexPolygon, which clips the edges first.
+static const float kMeshCoordLimit = 16384;
+
+static inline bool fanTriangleInRange(const GPoint pts[3]) {
+	for (int i = 0; i < 3; ++i) {
+		if (!(std::abs(pts[i].fX) <= kMeshCoordLimit && std::abs(pts[i].fY) <= kMeshCoordLimit)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// ceil(num / den) for den > 0
+static inline int64_t fan_ceil_div(int64_t num, int64_t den) {
+	return num >= 0 ? (num + den - 1) / den : -(-num / den);
+}
+
+// An edge between two vertices snapped to 1/kSubpixels of a pixel, with y0 <= y1. It covers
+// the rows whose centers are in [y0, y1): a center on its upper end is in, one on its lower
+// end is out.
+struct FanMeshEdge {
+	enum { kSubpixels = 256 };
+
+	int64_t x0, y0, dx, dy;
+
+	void set(int64_t ax, int64_t ay, int64_t bx, int64_t by) {
+		x0 = ax;
+		y0 = ay;
+		dx = bx - ax;
+		dy = by - ay;
+	}
+
+	// the first row whose center is at or below y (in subpixels)
+	static int Row(int64_t y) {
+		return (int)fan_ceil_div(y - kSubpixels / 2, kSubpixels);
+	}
+
+	int top() const { return Row(y0); }
+	int bottom() const { return Row(y0 + dy); }
+
+	// The first pixel whose center is on or right of the edge in row y: where a left edge's
+	// span starts and a right edge's span ends.
+	int column(int y) const {
+		// the edge crosses the row's center at x0 + dx * (cy - y0) / dy
+		int64_t cy = (int64_t)y * kSubpixels + kSubpixels / 2;
+		int64_t num = x0 * dy + dx * (cy - y0) - dy * (kSubpixels / 2);
+		return (int)fan_ceil_div(num, dy * kSubpixels);
+	}
+};
+
+// Calls proc(y, x0, x1) for the spans of the triangle (in device space, within
+// fanTriangleInRange) in the rows [clipTop, clipBottom), with x clipped to [0, width). Each
+// row is computed on its own, so a band of the device gets exactly the spans a full walk
+// would give it.
+template <typename SpanProc>
+static void fanWalkTriangle(const GPoint pts[3], int width, int clipTop, int clipBottom,
+	SpanProc proc) {
+	int64_t x[3], y[3];
+	for (int i = 0; i < 3; ++i) {
+		x[i] = (int64_t)floorf(pts[i].fX * FanMeshEdge::kSubpixels + 0.5f);
+		y[i] = (int64_t)floorf(pts[i].fY * FanMeshEdge::kSubpixels + 0.5f);
+	}
+
+	// a, b, c from top to bottom
+	int a = 0, b = 1, c = 2;
+	if (y[b] < y[a]) std::swap(a, b);
+	if (y[c] < y[b]) std::swap(b, c);
+	if (y[b] < y[a]) std::swap(a, b);
+
+	// which side of the long edge, a to c, the middle vertex is on (y grows downward)
+	int64_t cross = (x[b] - x[a]) * (y[c] - y[a]) - (y[b] - y[a]) * (x[c] - x[a]);
+	if (cross == 0) {
+		return;
+	}
+
+	FanMeshEdge longEdge, upper, lower;
+	longEdge.set(x[a], y[a], x[c], y[c]);
+	upper.set(x[a], y[a], x[b], y[b]);
+	lower.set(x[b], y[b], x[c], y[c]);
+	const int middle = lower.top();
+
+	int bottom = std::min(longEdge.bottom(), clipBottom);
+	for (int row = std::max(longEdge.top(), clipTop); row < bottom; ++row) {
+		int l = longEdge.column(row);
+		int r = (row < middle ? upper : lower).column(row);
+		if (cross < 0) {
+			std::swap(l, r);
+		}
+		l = std::max(0, l);
+		r = std::min(width, r);
+		if (l < r) {
+			proc(row, l, r);
+		}
+	}
+}
+
+static inline GVector fan_quad_step(GPoint a, GPoint b, float t) { return (b - a) * t; }
+static inline GColor fan_quad_step(const GColor& a, const GColor& b, float t) {
+	return Cmul(t, Cminus(b, a));
+}
+static inline void fan_quad_advance(GPoint& p, const GVector& d) { p += d; }
+static inline void fan_quad_advance(GColor& c, const GColor& d) { c = Cadd(c, d); }
+
+// Samples the bilinear blend of a quad's corners (points, colors or texture coordinates) on an
+// n x n grid: out[i * n + j] is at U = i / (n - 1) along corners 0 -> 1 and V = j / (n - 1)
+// along 0 -> 3. Each row's ends are blended from the corners, and the points in between are
+// stepped from one end to the other, so a vertex costs one add.
+template <typename T>
+static void fanTessellateQuad(const T corners[4], int n, T out[]) {
+	const float step = 1.0f / (n - 1);
+	for (int i = 0; i < n; ++i) {
+		const float U = (float)i / (n - 1);
+		T start = corners[0];
+		T end = corners[3];
+		fan_quad_advance(start, fan_quad_step(corners[0], corners[1], U));
+		fan_quad_advance(end, fan_quad_step(corners[3], corners[2], U));
+
+		const auto d = fan_quad_step(start, end, step);
+		T* row = out + i * n;
+		T p = start;
+		for (int j = 0; j < n - 1; ++j) {
+			row[j] = p;
+			fan_quad_advance(p, d);
+		}
+		row[n - 1] = end;
+	}
+}
+
+// What the fourth corner (index 2) of a quad would be if dst were an affine function of src,
+// fitted to the other three corners, minus what it is: how far the bilinear patch bends dst
+// away from src. Zero if src's corners are collinear.
+static inline float fan_quad_bend(const GPoint src[4], const GPoint dst[4]) {
+	GVector u = src[1] - src[0], v = src[3] - src[0], w = src[2] - src[0];
+	float det = u.fX * v.fY - u.fY * v.fX;
+	if (det == 0) {
+		return 0;
+	}
+	float a = (w.fX * v.fY - w.fY * v.fX) / det;
+	float b = (u.fX * w.fY - u.fY * w.fX) / det;
+	GPoint fit = dst[0] + (dst[1] - dst[0]) * a + (dst[3] - dst[0]) * b;
+	return (dst[2] - fit).length();
+}
+
+static inline float fan_quad_bend(const GPoint src[4], const GColor dst[4]) {
+	GVector u = src[1] - src[0], v = src[3] - src[0], w = src[2] - src[0];
+	float det = u.fX * v.fY - u.fY * v.fX;
+	if (det == 0) {
+		return 0;
+	}
+	float a = (w.fX * v.fY - w.fY * v.fX) / det;
+	float b = (u.fX * w.fY - u.fY * w.fX) / det;
+	GColor fit = Cadd(dst[0], Cadd(Cmul(a, Cminus(dst[1], dst[0])),
+								   Cmul(b, Cminus(dst[3], dst[0]))));
+	GColor d = Cminus(dst[2], fit);
+	return std::max(std::max(std::abs(d.fA), std::abs(d.fR)), std::max(std::abs(d.fG), std::abs(d.fB)));
+}
+
+// The level drawQuad uses for kAutoQuadLevel, for a quad whose corners land on device at
+// device[] (texs is null unless the paint has a shader to sample).
+//
+// Within each of n x n cells the triangles interpolate linearly what the patch blends
+// bilinearly; for a patch that bends by e at its fourth corner they are off by at most
+// e / (4 n^2). n is picked to keep that under half a pixel for the texture (measured on the
+// device) and under one step of 255 for the colors, but cells stay at least a pixel across (a
+// small quad gets few triangles), and there are at most kMaxCells of them per side.
+static int fanAutoQuadLevel(const GPoint device[4], const GColor colors[4], const GPoint texs[4]) {
+	const int kMaxCells = 256;
+
+	float n2 = 1;
+	if (texs) {
+		n2 = std::max(n2, fan_quad_bend(texs, device) / (4 * 0.5f));
+	}
+	if (colors) {
+		n2 = std::max(n2, fan_quad_bend(device, colors) * 255 / 4);
+	}
+
+	float extent = 0;
+	for (int i = 0; i < 4; ++i) {
+		extent = std::max(extent, (device[(i + 1) % 4] - device[i]).length());
+	}
+	float cells = std::min(sqrtf(n2), std::min(extent, (float)kMaxCells));
+	return std::max(1, GCeilToInt(cells)) - 1;
+}
+
+class FanMeshContext : public GShader::Context {
+public:
+	// texture is the paint's shader, or null if the mesh only has colors
+	FanMeshContext(const GMatrix& ctm, GShader* texture)
+		: fCTM(ctm), fTexture(texture), fHasTexture(false), fHasColors(false),
+		  fScratch(&fOwnScratch) {
+		fCTMInvertible = ctm.invert(&fCTMInverse);
+	}
+
+	// Points the context at a triangle: its vertices (before the CTM), and their colors and
+	// texture coordinates, either of which may be null. Returns false if the triangle cannot
+	// be shaded, e.g. it or its texture coordinates have no area.
+	bool setTriangle(const GPoint verts[3], const GColor colors[3], const GPoint texs[3]) {
+		fHasColors = colors != nullptr;
+		if (fHasColors) {
+			// colors[0] + u * (colors[1] - colors[0]) + v * (colors[2] - colors[0]), where
+			// (u, v) are the point's coordinates along the triangle's sides
+			GVector u = verts[1] - verts[0];
+			GVector v = verts[2] - verts[0];
+			GMatrix local, tmp;
+			local.set6(u.fX, v.fX, verts[0].fX, u.fY, v.fY, verts[0].fY);
+			tmp.setConcat(fCTM, local);
+			if (!tmp.invert(&fInverse)) {
+				return false;
+			}
+			fColor0 = colors[0];
+			fDC1 = Cminus(colors[1], colors[0]);
+			fDC2 = Cminus(colors[2], colors[0]);
+			// the color changes by the same amount from one pixel to the next
+			fDC = Cadd(Cmul(fInverse[GMatrix::SX], fDC1), Cmul(fInverse[GMatrix::KY], fDC2));
+		}
+
+		fHasTexture = false;
+		if (fTexture && texs) {
+			// maps the texture coordinates onto the vertices
+			GMatrix T, P, local;
+			GVector u = texs[1] - texs[0];
+			GVector v = texs[2] - texs[0];
+			T.set6(u.fX, v.fX, texs[0].fX, u.fY, v.fY, texs[0].fY);
+			u = verts[1] - verts[0];
+			v = verts[2] - verts[0];
+			P.set6(u.fX, v.fX, verts[0].fX, u.fY, v.fY, verts[0].fY);
+			if (!T.invert(&local)) {
+				return false;
+			}
+			local.postConcat(P);
+			if (!this->setTexture(local)) {
+				return false;
+			}
+		}
+		return fHasColors || fHasTexture;
+	}
+
+	// The same for a triangle of a GVertices, whose setup was done when it was made: color is
+	// its ColorSetup and texMatrix its texture matrix, either of which may be null.
+	bool setTriangle(const GVertices::ColorSetup* color, const GMatrix* texMatrix) {
+		fHasColors = color != nullptr;
+		if (fHasColors) {
+			// the setup is in terms of the mesh's coordinates, which the inverse CTM gives
+			if (!fCTMInvertible) {
+				return false;
+			}
+			fInverse = fCTMInverse;
+			fColor0 = color->fColor;
+			fDC1 = color->fDX;
+			fDC2 = color->fDY;
+			fDC = Cadd(Cmul(fInverse[GMatrix::SX], fDC1), Cmul(fInverse[GMatrix::KY], fDC2));
+		}
+
+		fHasTexture = false;
+		if (fTexture && texMatrix && !this->setTexture(*texMatrix)) {
+			return false;
+		}
+		return fHasColors || fHasTexture;
+	}
+
+	void shadeRow(int x, int y, int count, GPixel row[]) override {
+		if (!fHasTexture) {
+			this->shadeColors(x, y, count, row);
+			return;
+		}
+		if (!fHasColors) {
+			fTextureContext->shadeRow(x, y, count, row);
+			return;
+		}
+
+		GShader::Scratch::Row texture(fScratch, count);
+		GPixel* T = texture.get();
+		this->shadeColors(x, y, count, row);
+		fTextureContext->shadeRow(x, y, count, T);
+		for (int i = 0; i < count; i++) {
+			row[i] = Pmul(row[i], T[i]);
+		}
+	}
+
+	void setScratch(GShader::Scratch* scratch) override {
+		fScratch = scratch;
+		if (fTextureContext) {
+			fTextureContext->setScratch(scratch);
+		}
+	}
+
+private:
+	// texMatrix maps the texture's space onto the triangle, before the CTM. The texture's
+	// context is made for the first triangle and pointed at each next one; a new one is only
+	// made if it cannot be.
+	bool setTexture(const GMatrix& texMatrix) {
+		GMatrix tmp;
+		tmp.setConcat(fCTM, texMatrix);
+		if (!fTextureContext || !fTextureContext->setCTM(tmp)) {
+			fTextureContext = fTexture->makeContext(tmp);
+			if (!fTextureContext) {
+				return false;
+			}
+			fTextureContext->setScratch(fScratch);
+		}
+		fHasTexture = true;
+		return true;
+	}
+
+	void shadeColors(int x, int y, int count, GPixel row[]) const {
+		GPoint local = fInverse.mapXY(x + 0.5, y + 0.5);
+		GColor color = Cadd(Cadd(Cmul(local.fX, fDC1), Cmul(local.fY, fDC2)), fColor0);
+		for (int i = 0; i < count; i++) {
+			row[i] = color_to_pixel(color);
+			color = Cadd(color, fDC);
+		}
+	}
+
+	const GMatrix fCTM;
+	GMatrix fCTMInverse;
+	bool fCTMInvertible;
+	GShader* fTexture;
+	std::unique_ptr<Context> fTextureContext;
+	bool fHasTexture;
+
+	bool fHasColors;
+	GMatrix fInverse;
+	GColor fColor0;
+	GColor fDC1;
+	GColor fDC2;
+	GColor fDC;
+
+	GShader::Scratch fOwnScratch;
+	GShader::Scratch* fScratch;
+};
+
+#endif
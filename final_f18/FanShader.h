@@ -5,217 +5,509 @@
 #include "Utils.h"
 #include "include/GColor.h"
 #include "ShadeMode.h"
+#include "FanGradient.h"
+#include "FanFilter.h"
+#include "FanImage.h"
+#include <algorithm>
+#include <cstring>
 #include <vector>
 #include <iostream>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 
-class FanShader : public GShader{
+// Our shaders do their work in contexts (see GShader::makeContext). setContext()/shadeRow()
+// still work for callers of the original interface, through a context held by the shader.
+class ContextShader : public GShader {
+public:
+	ContextShader() {}
+
+	// a copy (see clone()) shares no context with the original
+	ContextShader(const ContextShader&) {}
+
+	bool setContext(const GMatrix& ctm) override {
+		fContext = this->makeContext(ctm);
+		return fContext != nullptr;
+	}
+
+	void shadeRow(int x, int y, int count, GPixel row[]) override {
+		fContext->shadeRow(x, y, count, row);
+	}
+
+private:
+	std::unique_ptr<Context> fContext;
+};
+
+class FanShader : public ContextShader {
 
 public:
 
-	FanShader(const GBitmap& device, const GMatrix& localMatrix, GShader::TileMode mode) {
+	FanShader(const GBitmap& device, const GMatrix& localMatrix, GShader::TileMode mode,
+		GShader::FilterQuality quality) {
 		fDevice = device;
 		scale.setScale(device.width(), device.height());
 		FanShader::localMatrix =  localMatrix;
 		this->mode = mode;
+		this->quality = quality;
+		fImage = FanImage::Find(device);
 	}
 
+	// the bitmap's flag, or the pixels checked once per generation (see FanImage)
 	bool isOpaque() {
-		bool result = true;
+		return FanImage::IsOpaque(fDevice);
+	}
 
-		for (int y = 0; y < fDevice.height(); ++y) {
-			GPixel* row = fDevice.getAddr(0, y);
-			for (int x = 0; x < fDevice.width(); ++x) {
-				if (GPixel_GetA(row[x]) != 0) {
-					result = false;
-				}
-			}
+	// The copy keeps its own copy of the pixels, since the caller may free them once the shader
+	// is gone. Bitmaps bigger than kMaxClonePixels are not copied.
+	std::unique_ptr<GShader> clone() const override {
+		const int w = fDevice.width(), h = fDevice.height();
+		if ((int64_t)w * h > kMaxClonePixels) {
+			return nullptr;
+		}
+		std::unique_ptr<FanShader> copy(new FanShader(*this));
+		copy->fPixels.resize((size_t)w * h);
+		for (int y = 0; y < h; ++y) {
+			memcpy(&copy->fPixels[(size_t)y * w], fDevice.getAddr(0, y), w * sizeof(GPixel));
 		}
+		copy->fDevice = GBitmap(w, h, w * sizeof(GPixel), copy->fPixels.data(),
+								FanImage::IsOpaque(fDevice));
+		copy->fImage = FanImage::Find(copy->fDevice);
+		return std::move(copy);
+	}
 
-		return result;
+	std::unique_ptr<Context> makeContext(const GMatrix& ctm) override {
+		GMatrix inverse;
+		GBitmap bitmap;
+		if (!this->setup(ctm, &inverse, &bitmap)) {
+			return nullptr;
+		}
+		switch (mode) {
+			case kClamp:
+				return this->makeTiledContext<kClamp>(bitmap, inverse);
+			case kRepeat:
+				return this->makeTiledContext<kRepeat>(bitmap, inverse);
+			default:
+				return this->makeTiledContext<kMirror>(bitmap, inverse);
+		}
 	}
-	 
-	bool setContext(const GMatrix& ctm) {
-		// fInverse is a private matrix stored in MyShader.
+
+private:
+	// What a context for ctm samples: the inverse, which maps device pixels into the unit
+	// square, and the bitmap to read there. Any mip level can be sampled with that inverse;
+	// filtered draws pick one by how many full-size pixels a step along each device axis
+	// crosses, nearest sampling always reads the bitmap's own pixels. Returns false, leaving
+	// both untouched, if the matrix is not invertible.
+	bool setup(const GMatrix& ctm, GMatrix* inverse, GBitmap* bitmap) const {
 		GMatrix tmp;
 		tmp.setConcat(ctm,localMatrix);
 		tmp.preConcat(scale);
-		return tmp.invert(&fInverse);
+
+		GMatrix inv;
+		if (!tmp.invert(&inv)) {
+			return false;
+		}
+		*inverse = inv;
+		*bitmap = fDevice;
+		if (quality != kNearest) {
+			const float w = fDevice.width(), h = fDevice.height();
+			float sx = std::hypot(inv[GMatrix::SX] * w, inv[GMatrix::KY] * h);
+			float sy = std::hypot(inv[GMatrix::KX] * w, inv[GMatrix::SY] * h);
+			*bitmap = fImage->level(FanImage::LevelForScale(std::max(sx, sy)));
+		}
+		return true;
+	}
+
+	template <int Mode>
+	std::unique_ptr<Context> makeTiledContext(const GBitmap& bitmap, const GMatrix& inverse) {
+		switch (quality) {
+			case kBilinear:
+				return std::unique_ptr<Context>(new FilterContext<2, Mode>(*this, bitmap, inverse));
+			case kBicubic:
+				return std::unique_ptr<Context>(new FilterContext<4, Mode>(*this, bitmap, inverse));
+			default:
+				return std::unique_ptr<Context>(new BitmapContext<Mode>(*this, bitmap, inverse));
+		}
 	}
 
-	void shadeRow(int x, int y, int count, GPixel row[]) {
+	template <int Mode>
+	class BitmapContext : public Context {
+	public:
+		BitmapContext(const FanShader& shader, const GBitmap& bitmap, const GMatrix& inverse)
+			: fShader(shader), fBitmap(bitmap), fInverse(inverse) {}
+
+		bool setCTM(const GMatrix& ctm) override {
+			return fShader.setup(ctm, &fInverse, &fBitmap);
+		}
 
-		/*const float dx = fInverse[GMatrix::SX];
-		const float dy = fInverse[GMatrix::KY];*/
-		GPoint local;
+		// Only the first pixel is mapped; every next one is a step along the x-derivative of
+		// the inverse (SX, KY).
+		void shadeRow(int x, int y, int count, GPixel row[]) override {
+			GPoint local = fInverse.mapXY(x + 0.5, y + 0.5);
+			const float dx = fInverse[GMatrix::SX];
+			const float dy = fInverse[GMatrix::KY];
 
-		for (int i = 0; i < count; ++i) {
-			local = fInverse.mapXY(x + i+ 0.5, y + 0.5);
-			
-			// clip points into the canvas
-			(*shadeMode[mode])(local.fX);
-			(*shadeMode[mode])(local.fY);
-			
-			local = scale.mapXY(local.fX, local.fY);
+			if (this->shadeRowFixed(local, dx, dy, count, row)) {
+				return;
+			}
 
-			// use local to lookup/compute a color
-			row[i] =*fDevice.getAddr((int)local.fX, (int)local.fY);
+			const int w = fBitmap.width();
+			const int h = fBitmap.height();
+			for (int i = 0; i < count; ++i) {
+				// clip points into the canvas
+				GPoint p = GPoint::Make(tile_unit<Mode>(local.fX), tile_unit<Mode>(local.fY));
 
+				// p may be 1, which is a texel past the edge: tile the index as the fixed loop does
+				row[i] = *fBitmap.getAddr(tile_index<Mode, false>((int)(p.fX * w), w),
+										  tile_index<Mode, false>((int)(p.fY * h), h));
+
+				local.fX += dx;
+				local.fY += dy;
+			}
 		}
-	}
 
-private:
+		// Steps in 16.16 pixel coordinates and tiles the integer index. Returns false (and
+		// leaves the row to the float loop) when the row's coordinates do not fit.
+		bool shadeRowFixed(GPoint local, float dx, float dy, int count, GPixel row[]) {
+			const int w = fBitmap.width();
+			const int h = fBitmap.height();
+			const float x0 = local.fX * w, x1 = (local.fX + dx * count) * w;
+			const float y0 = local.fY * h, y1 = (local.fY + dy * count) * h;
+			const float kLimit = 32000;
+			if (!(std::max(std::abs(x0), std::abs(x1)) < kLimit &&
+				  std::max(std::abs(y0), std::abs(y1)) < kLimit)) {
+				return false;
+			}
+
+			GFixed fx = GFloatToFixed(x0);
+			GFixed fy = GFloatToFixed(y0);
+			const GFixed fdx = GFloatToFixed(dx * w);
+			const GFixed fdy = GFloatToFixed(dy * h);
+			if (is_pow2(w) && is_pow2(h)) {
+				this->shadeFixed<true>(fx, fy, fdx, fdy, count, row);
+			} else {
+				this->shadeFixed<false>(fx, fy, fdx, fdy, count, row);
+			}
+			return true;
+		}
+
+		// The indices are tiled kBatch at a time, then the pixels fetched. Rows that stay on one
+		// line of the bitmap (fdy == 0) tile y once.
+		template <bool kPow2>
+		void shadeFixed(GFixed fx, GFixed fy, GFixed fdx, GFixed fdy, int count, GPixel row[]) {
+			const int w = fBitmap.width();
+			const int h = fBitmap.height();
+			int xs[kBatch], ys[kBatch];
+
+			if (fdy == 0) {
+				const GPixel* line = fBitmap.getAddr(0, tile_index<Mode, kPow2>(fy >> 16, h));
+				for (int i = 0; i < count; i += kBatch) {
+					int n = std::min((int)kBatch, count - i);
+					fixed_indices<kPow2>(fx + i * fdx, fdx, w, n, xs);
+					for (int j = 0; j < n; ++j) {
+						row[i + j] = line[xs[j]];
+					}
+				}
+				return;
+			}
+
+			const GPixel* pixels = fBitmap.pixels();
+			const size_t stride = fBitmap.rowBytes() >> 2;
+			for (int i = 0; i < count; i += kBatch) {
+				int n = std::min((int)kBatch, count - i);
+				fixed_indices<kPow2>(fx + i * fdx, fdx, w, n, xs);
+				fixed_indices<kPow2>(fy + i * fdy, fdy, h, n, ys);
+				for (int j = 0; j < n; ++j) {
+					row[i + j] = pixels[ys[j] * stride + xs[j]];
+				}
+			}
+		}
+
+		// the tiled integer parts of f, f + df, f + 2df, ...: four to a vector for the modes
+		// that need no division
+		template <bool kPow2>
+		static void fixed_indices(GFixed f, GFixed df, int size, int count, int out[]) {
+			int i = 0;
+#if defined(__SSE2__)
+			if (Mode == GShader::kClamp || kPow2) {
+				const __m128i step = _mm_set1_epi32(4 * df);
+				__m128i v = _mm_setr_epi32(f, f + df, f + 2 * df, f + 3 * df);
+				for (; i + 4 <= count; i += 4) {
+					__m128i index = tile_index_x4<Mode>(_mm_srai_epi32(v, 16), size);
+					_mm_storeu_si128((__m128i*)(out + i), index);
+					v = _mm_add_epi32(v, step);
+				}
+				f += i * df;
+			}
+#endif
+			for (; i < count; ++i) {
+				out[i] = tile_index<Mode, kPow2>(f >> 16, size);
+				f += df;
+			}
+		}
+
+		enum { kBatch = 64 };
+
+		const FanShader& fShader;
+		GBitmap fBitmap;
+		GMatrix fInverse;
+	};
+
+	// Bilinear (N = 2) or bicubic (N = 4) sampling, see FanFilter.h. Rows that stay on one line
+	// of the bitmap (scale and translate, KY == 0) find their y taps once; if they also move one
+	// texel per pixel (translate only) their x weights are the same for every pixel as well.
+	template <int N, int Mode>
+	class FilterContext : public Context {
+	public:
+		FilterContext(const FanShader& shader, const GBitmap& bitmap, const GMatrix& inverse)
+			: fShader(shader), fBitmap(bitmap), fInverse(inverse) {}
+
+		bool setCTM(const GMatrix& ctm) override {
+			return fShader.setup(ctm, &fInverse, &fBitmap);
+		}
+
+		void shadeRow(int x, int y, int count, GPixel row[]) override {
+			const GBitmap& bm = fBitmap;
+			const int w = bm.width();
+			const int h = bm.height();
+
+			// in texels
+			GPoint local = fInverse.mapXY(x + 0.5, y + 0.5);
+			float fx = local.fX * w;
+			float fy = local.fY * h;
+			const float dx = fInverse[GMatrix::SX] * w;
+			const float dy = fInverse[GMatrix::KY] * h;
+
+			const GPixel* rows[N];
+			int xs[N], ys[N];
+			float wx[N], wy[N];
+
+			if (dy != 0) {
+				for (int i = 0; i < count; ++i) {
+					filter_taps<N, Mode>(fx, w, xs, wx);
+					filter_taps<N, Mode>(fy, h, ys, wy);
+					for (int j = 0; j < N; ++j) {
+						rows[j] = bm.getAddr(0, ys[j]);
+					}
+					row[i] = filter_sample<N>(rows, xs, wx, wy);
+					fx += dx;
+					fy += dy;
+				}
+				return;
+			}
+
+			filter_taps<N, Mode>(fy, h, ys, wy);
+			for (int j = 0; j < N; ++j) {
+				rows[j] = bm.getAddr(0, ys[j]);
+			}
+
+			if (std::abs(dx - 1) < 1.0e-6f) {
+				const int x0 = filter_weights<N>(fx, wx);
+				for (int i = 0; i < count; ++i) {
+					filter_index<N, Mode>(x0 + i, w, xs);
+					row[i] = filter_sample<N>(rows, xs, wx, wy);
+				}
+				return;
+			}
+
+			for (int i = 0; i < count; ++i) {
+				filter_taps<N, Mode>(fx, w, xs, wx);
+				row[i] = filter_sample<N>(rows, xs, wx, wy);
+				fx += dx;
+			}
+		}
+
+	private:
+		const FanShader& fShader;
+		GBitmap fBitmap;
+		GMatrix fInverse;
+	};
+
+	enum { kMaxClonePixels = 1 << 16 };
+
 	GMatrix localMatrix;
-	GMatrix inverseScale;
-	GMatrix fInverse;
 	GMatrix scale;
 	GBitmap fDevice;
+	std::vector<GPixel> fPixels;  // fDevice's pixels in a copy (see clone())
+	std::shared_ptr<FanImage> fImage;
 	GShader::TileMode mode;
+	GShader::FilterQuality quality;
 };
 
-class LinearShader : public GShader {
+class LinearShader : public ContextShader {
 
 public:
 	LinearShader(GPoint p0, GPoint p1, const GColor* colors, int count, GShader::TileMode mode) {
 		this->count = count;
-		
+
 		float dx = p1.fX - p0.fX;
 		float dy = p1.fY - p0.fY;
 		localMatrix.set6(dx,-dy,p0.fX,dy,dx,p0.fY);
 		this->mode = mode;
-		
-		
+
+
 		for (int i = 0; i < count; i++) {
 			this->colors.push_back(colors[i]);
 		}
-
+		fLUT = FanGradientLUT::Find(colors, count);
 	}
 
 	bool isOpaque() {
-
-		bool result = true;
-
-		for (int i=0; i<count; ++i) {
-			if (colors[i].fA != 0) {
-				result = false;
+		for (int i = 0; i < count; ++i) {
+			if (colors[i].fA < 1) {
+				return false;
 			}
 		}
-		return result;
+		return true;
+	}
 
+	std::unique_ptr<GShader> clone() const override {
+		return std::unique_ptr<GShader>(new LinearShader(*this));
 	}
 
-	bool setContext(const GMatrix& ctm) {
+	std::unique_ptr<Context> makeContext(const GMatrix& ctm) override {
 		GMatrix tmp;
 		tmp.setConcat(ctm, localMatrix);
 
-		return tmp.invert(&fInverse);
+		GMatrix inverse;
+		if (!tmp.invert(&inverse)) {
+			return nullptr;
+		}
+		switch (mode) {
+			case kClamp:
+				return std::unique_ptr<Context>(new LinearContext<kClamp>(*this, inverse));
+			case kRepeat:
+				return std::unique_ptr<Context>(new LinearContext<kRepeat>(*this, inverse));
+			default:
+				return std::unique_ptr<Context>(new LinearContext<kMirror>(*this, inverse));
+		}
 	}
 
-	void shadeRow(int x, int y, int count, GPixel* row) {
-
-		//for (int i = 0; i < this->count; i++) {
-		//	//std::cout << colors[i].fA << " " << colors[i].fR << " " << colors[i].fG << " " << colors[i].fB << std::endl;
-		//	if (colors[i].fG == 100) {
-		//		std::cout << " 100 !" << std::endl;
-		//		std::cout << "y " << y << std::endl;
-		//	}
-		//
-		//}
-
-
-		for (int i = 0; i < count; i++) {
-			GPoint local = fInverse.mapXY( x+i + 0.5, y + 0.5);
-			float mx = local.fX;
-
-			(*shadeMode[mode])(mx);
-
-			/*std::cout << "mx: "<<mx << std::endl;*/
-
-			int intervals = this->count - 1;
-			
-			int left = GFloorToInt(mx*intervals);
-			int right = GCeilToInt(mx*intervals);
-
-
-			/*std::cout << "left: "<<left << std::endl;
-			std::cout << "right: " << right<< std::endl;*/
-		
-			float u = mx * intervals - left;
-			float v = 1 - u;
-			GColor out_c;
-
-			float a = v * this->colors[left].fA + u * this->colors[right].fA;
-			float r = v * this->colors[left].fR + u * this->colors[right].fR;
-			float g = v * this->colors[left].fG + u * this->colors[right].fG;
-			float b = v * this->colors[left].fB + u * this->colors[right].fB;
-
-			out_c = GColor::MakeARGB(a,r,g,b);
+private:
+	template <int Mode>
+	class LinearContext : public Context {
+	public:
+		LinearContext(const LinearShader& shader, const GMatrix& inverse)
+			: fShader(shader), fInverse(inverse) {}
+
+		void shadeRow(int x, int y, int count, GPixel* row) override {
+			if (fInverse[GMatrix::SX] == 0) {
+				// vertical: local x is the same all along the row
+				GPixel color;
+				this->shadeSpan(x, y, 1, &color);
+				std::fill_n(row, count, color);
+			} else if (fInverse[GMatrix::KX] == 0) {
+				this->shadeCached(x, y, count, row);
+			} else {
+				this->shadeSpan(x, y, count, row);
+			}
+		}
 
-			//std::cout << "out_c A: " << out_c.fA << ", out_c R: " << out_c.fR << ", out_c G: " << out_c.fG << ", out_c B: " << out_c.fB << std::endl;
-			/*if (out_c.fG == 99.5) {
-				for (int i = 0; i < this->count; i++) {
-					std::cout << colors[i].fA << " " << colors[i].fR << " " << colors[i].fG << " " << colors[i].fB << std::endl;
-				}
+		unsigned flags() const override {
+			return fInverse[GMatrix::SX] == 0 ? kConstantRow_Flag : 0;
+		}
 
-				std::cout << "u " << u << " v: " << v<< std::endl;
-				std::cout << "left: " << left << std::endl;
-				std::cout << "right: " << right << std::endl;
-				std::cout << "count: " << this->count << std::endl;
-				std::cout << "left G " << colors[left].fG << "right G" << colors[right].fG << std::endl;
-			}*/
+		bool setCTM(const GMatrix& ctm) override {
+			GMatrix tmp;
+			tmp.setConcat(ctm, fShader.localMatrix);
+			if (!tmp.invert(&fInverse)) {
+				return false;
+			}
+			fCache.clear();
+			return true;
+		}
 
+		void shadeSpan(int x, int y, int count, GPixel* row) {
+			const FanGradientLUT& lut = *fShader.fLUT;
 
-			GPixel out_p = color_to_pixel(out_c);
+			// the gradient only depends on local x, which changes by SX from one pixel to the next
+			float lx = fInverse.mapXY(x + 0.5, y + 0.5).fX;
+			const float dx = fInverse[GMatrix::SX];
 
-			//std::cout << "out_p A: " << GPixel_GetA(out_p) << ", out_p R: " << GPixel_GetR(out_p) << ", out_p G: " << GPixel_GetG(out_p) << ", out_p B: " << GPixel_GetB(out_p) << std::endl;
+			for (int i = 0; i < count; i++) {
+				float mx = tile_unit<Mode>(lx);
+				lx += dx;
 
+				row[i] = lut.lookup(mx);
+			}
+		}
 
-			row[i] = out_p;
+		// Horizontal: local x does not depend on y, so every row is the same function of x. The
+		// columns shaded so far are kept (starting at fCacheX) and copied into later rows; a span
+		// that reaches past them reshades the union.
+		void shadeCached(int x, int y, int count, GPixel* row) {
+			int cacheEnd = fCacheX + (int)fCache.size();
+			if (fCache.empty() || x < fCacheX || x + count > cacheEnd) {
+				int left = fCache.empty() ? x : std::min(x, fCacheX);
+				int right = fCache.empty() ? x + count : std::max(x + count, cacheEnd);
+				fCache.resize(right - left);
+				this->shadeSpan(left, y, right - left, fCache.data());
+				fCacheX = left;
+			}
+			memcpy(row, &fCache[x - fCacheX], count * sizeof(GPixel));
 		}
-	}
 
+		const LinearShader& fShader;
+		GMatrix fInverse;
+		std::vector<GPixel> fCache;
+		int fCacheX = 0;
+	};
 
-private:
 	GMatrix localMatrix;
-	GMatrix fInverse;
 	int count;
 	std::vector<GColor> colors;
+	std::shared_ptr<const FanGradientLUT> fLUT;
 	GShader::TileMode mode;
 };
 
-class SingleShader : public GShader {
+class SingleShader : public ContextShader {
 public:
 	SingleShader( GColor color) {
 		this->color = color;
 	}
 
 	bool isOpaque() {
-		if (this->color.fA == 0) {
-			return true;
-		}
-		return false;
+		return this->color.fA >= 1;
 	}
 
-	void shadeRow(int x, int y, int count, GPixel* row) {
-		GPixel out = color_to_pixel(this->color);
-		for (int i = 0; i < count; i++) {
-			row[i] = out;
-		}
+	std::unique_ptr<GShader> clone() const override {
+		return std::unique_ptr<GShader>(new SingleShader(*this));
 	}
 
-	bool setContext(const GMatrix& ctm) {
-		return true;
+	std::unique_ptr<Context> makeContext(const GMatrix& ctm) override {
+		return std::unique_ptr<Context>(new SingleContext(color_to_pixel(this->color)));
 	}
 
-
 private:
+	class SingleContext : public Context {
+	public:
+		SingleContext(GPixel pixel) : fPixel(pixel) {}
+
+		void shadeRow(int x, int y, int count, GPixel* row) override {
+			for (int i = 0; i < count; i++) {
+				row[i] = fPixel;
+			}
+		}
+
+		unsigned flags() const override {
+			return kConstantRow_Flag;
+		}
+
+		// the color does not depend on the matrix
+		bool setCTM(const GMatrix&) override {
+			return true;
+		}
+
+		GPixel fPixel;
+	};
+
 	GColor color;
 
 };
 
-class TricolorShader :public GShader {
+class TricolorShader : public ContextShader {
 public:
-	TricolorShader(GPoint points[],GColor colors[]) {
+	TricolorShader(const GPoint points[], const GColor colors[]) {
 		for (int i = 0; i < 3; i++) {
 			this->colors[i] = colors[i];
 		}
@@ -230,42 +522,66 @@ public:
 
 	bool isOpaque() {
 		for (int i = 0; i < 3; i++) {
-			if (colors[i].fA == 0.0) {
-				return true;
-			}	
+			if (colors[i].fA < 1) {
+				return false;
+			}
 		}
-		return false;
+		return true;
 	}
 
-	bool setContext(const GMatrix& ctm) {
-		GMatrix tmp;
-		tmp.setConcat(ctm, localMatrix);
-		return tmp.invert(&fInverse);
+	std::unique_ptr<GShader> clone() const override {
+		return std::unique_ptr<GShader>(new TricolorShader(*this));
 	}
 
-	void shadeRow(int x, int y, int count, GPixel row[]) {
-		GPoint local=fInverse.mapXY(x+0.5, y+0.5);
-		GColor color;
-		color = Cadd(Cadd(Cmul(local.fX , DC1) , Cmul(local.fY,DC2)) , colors[0]);
-		float a = fInverse[GMatrix::SX];
-		float d = fInverse[GMatrix::KY];
-		GColor DC = Cadd(Cmul(a, DC1), Cmul(d, DC2));
-
-		for (int i = 0; i < count; i++) {
-			row[i] = color_to_pixel(color);
-			color = Cadd(color, DC);
+	std::unique_ptr<Context> makeContext(const GMatrix& ctm) override {
+		std::unique_ptr<TricolorContext> context(new TricolorContext(*this));
+		if (!context->setCTM(ctm)) {
+			return nullptr;
 		}
+		return std::move(context);
 	}
 
 private:
+	class TricolorContext : public Context {
+	public:
+		TricolorContext(const TricolorShader& shader) : fShader(shader) {}
+
+		bool setCTM(const GMatrix& ctm) override {
+			GMatrix tmp;
+			tmp.setConcat(ctm, fShader.localMatrix);
+			if (!tmp.invert(&fInverse)) {
+				return false;
+			}
+			// the color changes by the same amount from one pixel to the next
+			float a = fInverse[GMatrix::SX];
+			float d = fInverse[GMatrix::KY];
+			fDC = Cadd(Cmul(a, fShader.DC1), Cmul(d, fShader.DC2));
+			return true;
+		}
+
+		void shadeRow(int x, int y, int count, GPixel row[]) override {
+			GPoint local=fInverse.mapXY(x+0.5, y+0.5);
+			GColor color;
+			color = Cadd(Cadd(Cmul(local.fX , fShader.DC1) , Cmul(local.fY,fShader.DC2)) , fShader.colors[0]);
+
+			for (int i = 0; i < count; i++) {
+				row[i] = color_to_pixel(color);
+				color = Cadd(color, fDC);
+			}
+		}
+
+		const TricolorShader& fShader;
+		GMatrix fInverse;
+		GColor fDC;
+	};
+
 	GMatrix localMatrix;
-	GMatrix fInverse;
 	GColor colors[3];
 	GColor DC1;
 	GColor DC2;
 };
 
-class ProxyShader :public GShader {
+class ProxyShader : public ContextShader {
 public:
 	ProxyShader(GShader* real,const GPoint points[3],const GPoint tex[3]) {
 		this->real = real;
@@ -278,8 +594,9 @@ public:
 		u = points[1] - points[0];
 		v = points[2] - points[0];
 		P.set6(u.fX, v.fX, points[0].fX, u.fY, v.fY, points[0].fY);
-		
-		T.invert(&localMatrix);
+
+		// texture coordinates with no area cannot be mapped onto the triangle
+		invertible = T.invert(&localMatrix);
 		localMatrix.postConcat(P);
 	}
 
@@ -287,23 +604,54 @@ public:
 		return real->isOpaque();
 	}
 
-	bool setContext(const GMatrix& ctm) {
+	std::unique_ptr<Context> makeContext(const GMatrix& ctm) override {
+		if (!invertible) {
+			return nullptr;
+		}
 		GMatrix tmp;
 		tmp.setConcat(ctm, localMatrix);
-		return real->setContext(tmp);
+		std::unique_ptr<Context> context = real->makeContext(tmp);
+		if (!context) {
+			return nullptr;
+		}
+		return std::unique_ptr<Context>(new ProxyContext(*this, std::move(context)));
 	}
 
-	void shadeRow(int x, int y, int count, GPixel row[]) {
-		real->shadeRow(x, y, count, row);
-	}
+private:
+	// the real shader's context, which a new CTM reaches through the local matrix
+	class ProxyContext : public Context {
+	public:
+		ProxyContext(const ProxyShader& shader, std::unique_ptr<Context> real)
+			: fShader(shader), fReal(std::move(real)) {}
+
+		void shadeRow(int x, int y, int count, GPixel row[]) override {
+			fReal->shadeRow(x, y, count, row);
+		}
 
+		unsigned flags() const override {
+			return fReal->flags();
+		}
+
+		void setScratch(Scratch* scratch) override {
+			fReal->setScratch(scratch);
+		}
+
+		bool setCTM(const GMatrix& ctm) override {
+			GMatrix tmp;
+			tmp.setConcat(ctm, fShader.localMatrix);
+			return fReal->setCTM(tmp);
+		}
+
+		const ProxyShader& fShader;
+		std::unique_ptr<Context> fReal;
+	};
 
-private:
 	GShader* real;
 	GMatrix localMatrix;
+	bool invertible;
 };
 
-class ComposeShader : public GShader {
+class ComposeShader : public ContextShader {
 public:
 	ComposeShader(GShader* s1, GShader* s2) {
 		this->s1 = s1;
@@ -314,28 +662,58 @@ public:
 		return (s1->isOpaque() && s2->isOpaque());
 	}
 
-	bool setContext(const GMatrix& ctm) {
-		return (s1->setContext(ctm) && s2->setContext(ctm));
+	std::unique_ptr<Context> makeContext(const GMatrix& ctm) override {
+		std::unique_ptr<Context> c1 = s1->makeContext(ctm);
+		std::unique_ptr<Context> c2 = s2->makeContext(ctm);
+		if (!c1 || !c2) {
+			return nullptr;
+		}
+		return std::unique_ptr<Context>(new ComposeContext(std::move(c1), std::move(c2)));
 	}
 
-	void shadeRow(int x, int y, int count, GPixel* row) {
-		GPixel A[count];
-		GPixel B[count];
-		s1->shadeRow(x, y, count, A);
-		s2->shadeRow(x, y, count, B);
-		
-		for (int i = 0; i < count; i++) {
-			row[i] = Pmul(A[i], B[i]);
+private:
+	class ComposeContext : public Context {
+	public:
+		ComposeContext(std::unique_ptr<Context> c1, std::unique_ptr<Context> c2)
+			: fC1(std::move(c1)), fC2(std::move(c2)), fScratch(&fOwnScratch) {}
+
+		// the first shader's colors go straight into row; only the second's need a scratch row
+		void shadeRow(int x, int y, int count, GPixel* row) override {
+			Scratch::Row other(fScratch, count);
+			GPixel* B = other.get();
+			fC1->shadeRow(x, y, count, row);
+			fC2->shadeRow(x, y, count, B);
+
+			for (int i = 0; i < count; i++) {
+				row[i] = Pmul(row[i], B[i]);
+			}
 		}
 
-	}
+		unsigned flags() const override {
+			return fC1->flags() & fC2->flags();
+		}
+
+		void setScratch(Scratch* scratch) override {
+			fScratch = scratch;
+			fC1->setScratch(scratch);
+			fC2->setScratch(scratch);
+		}
+
+		bool setCTM(const GMatrix& ctm) override {
+			return fC1->setCTM(ctm) && fC2->setCTM(ctm);
+		}
+
+		std::unique_ptr<Context> fC1;
+		std::unique_ptr<Context> fC2;
+		Scratch fOwnScratch;
+		Scratch* fScratch;
+	};
 
-private:
 	GShader* s1;
 	GShader* s2;
 };
 
-class RadialShader :public GShader {
+class RadialShader : public ContextShader {
 public:
 	RadialShader(GPoint center, float radius,
 		const GColor colors[], int count, GShader::TileMode mode) {
@@ -346,80 +724,139 @@ public:
 		for (int i = 0; i < count; i++) {
 			this->colors.push_back(colors[i]);
 		}
+		fLUT = FanGradientLUT::Find(colors, count);
 
 		this->mode = mode;
 	}
 
 	bool isOpaque() {
 		for (int i = 0; i < count; i++) {
-			if (colors[i].fA == 0) {
+			if (colors[i].fA < 1) {
 				return false;
 			}
 		}
 		return true;
 	}
 
-	bool setContext(const GMatrix& ctm) {
-		GMatrix tmp;
-		tmp.setConcat(ctm, localMatrix);
-
-		return tmp.invert(&fInverse);
+	std::unique_ptr<GShader> clone() const override {
+		return std::unique_ptr<GShader>(new RadialShader(*this));
 	}
 
+	std::unique_ptr<Context> makeContext(const GMatrix& ctm) override {
+		std::unique_ptr<RadialContext> context(new RadialContext(*this));
+		if (!context->setCTM(ctm)) {
+			return nullptr;
+		}
+		return std::move(context);
+	}
 
-	void shadeRow(int x, int y, int count, GPixel row[]) {
-		GPoint local = fInverse.mapXY(x + 0.5, y + 0.5);
-		float dx = fInverse[GMatrix::SX];
-		float dy = fInverse[GMatrix::KY];
-		GPoint origin = GPoint::Make(0, 0);
-		int intervals = this->count - 1;
-		GColor out_c;
-		GPixel out_p;
-
-		for (int i = 0; i < count; i++) {
-			float d = calc_dist(local, origin);
-
-			(*shadeMode[mode])(d);
+private:
+	class RadialContext : public Context {
+	public:
+		RadialContext(const RadialShader& shader) : fShader(shader) {}
+
+		bool setCTM(const GMatrix& ctm) override {
+			GMatrix tmp;
+			tmp.setConcat(ctm, fShader.localMatrix);
+			return tmp.invert(&fInverse);
+		}
 
-			int left = GFloorToInt(d*intervals);
-			int right = GCeilToInt(d*intervals);
+		// The squared distance is forward-differenced: from one pixel to the next it grows by
+		// 2(x*dx + y*dy) + dx^2 + dy^2, and that step grows by 2(dx^2 + dy^2). It is computed
+		// exactly at the start of every batch of kBatch pixels, whose square roots are then
+		// taken together.
+		void shadeRow(int x, int y, int count, GPixel row[]) override {
+			const FanGradientLUT& lut = *fShader.fLUT;
+			GPoint local = fInverse.mapXY(x + 0.5, y + 0.5);
+			const float dx = fInverse[GMatrix::SX];
+			const float dy = fInverse[GMatrix::KY];
+			const float dd = dx * dx + dy * dy;
+			float d[kBatch];
+
+			for (int i = 0; i < count; i += kBatch) {
+				float d2 = local.fX * local.fX + local.fY * local.fY;
+				float step = 2 * (local.fX * dx + local.fY * dy) + dd;
+				for (int j = 0; j < kBatch; ++j) {
+					// rounding can take it just below 0 next to the center
+					d[j] = std::max(d2, 0.0f);
+					d2 += step;
+					step += 2 * dd;
+				}
+				sqrt_batch(d);
 
-			float u = d * intervals - left;
-			float v = 1 - u;
-			
+				int n = std::min((int)kBatch, count - i);
+				tile_batch(d, n, fShader.mode);
+				for (int j = 0; j < n; ++j) {
+					row[i + j] = lut.lookup(d[j]);
+				}
 
-			float a = v * this->colors[left].fA + u * this->colors[right].fA;
-			float r = v * this->colors[left].fR + u * this->colors[right].fR;
-			float g = v * this->colors[left].fG + u * this->colors[right].fG;
-			float b = v * this->colors[left].fB + u * this->colors[right].fB;
+				local.fX += kBatch * dx;
+				local.fY += kBatch * dy;
+			}
+		}
 
-			out_c = GColor::MakeARGB(a, r, g, b);
-			out_p = color_to_pixel(out_c);
+		enum { kBatch = 8 };
 
-			row[i] = out_p;
+		static void sqrt_batch(float d[kBatch]) {
+#if defined(__SSE2__)
+			_mm_storeu_ps(d, _mm_sqrt_ps(_mm_loadu_ps(d)));
+			_mm_storeu_ps(d + 4, _mm_sqrt_ps(_mm_loadu_ps(d + 4)));
+#else
+			for (int j = 0; j < kBatch; ++j) {
+				d[j] = sqrtf(d[j]);
+			}
+#endif
+		}
 
-			local.fX += dx;
-			local.fY += dy;
+		// The tile mode is picked once per batch rather than for every pixel.
+		// Distances are never negative, so truncating is flooring and no floorf() is needed.
+		static void tile_batch(float d[], int n, GShader::TileMode mode) {
+			switch (mode) {
+				case GShader::kClamp:
+					for (int j = 0; j < n; ++j) {
+						d[j] = std::min(d[j], 1.0f);
+					}
+					break;
+				case GShader::kRepeat:
+					for (int j = 0; j < n; ++j) {
+						d[j] -= (int)d[j];
+					}
+					break;
+				case GShader::kMirror:
+					for (int j = 0; j < n; ++j) {
+						float h = d[j] / 2;
+						h -= (int)h;
+						d[j] = (h > 0.5f ? 1 - h : h) * 2;
+					}
+					break;
+			}
 		}
-	}
 
-private:
+		const RadialShader& fShader;
+		GMatrix fInverse;
+	};
+
 	int count;
 	std::vector<GColor> colors;
+	std::shared_ptr<const FanGradientLUT> fLUT;
 	GShader::TileMode mode;
 	GMatrix localMatrix;
-	GMatrix fInverse;
 };
 
 
 
 
-std::unique_ptr<GShader> GCreateBitmapShader(const GBitmap& device, const GMatrix& localMatrix, GShader::TileMode mode) {
+
+
+
+
+std::unique_ptr<GShader> GCreateBitmapShader(const GBitmap& device, const GMatrix& localMatrix, GShader::TileMode mode,
+	GShader::FilterQuality quality) {
 	if (&device==nullptr || &localMatrix==nullptr) {
 		return nullptr;
 	}
 
-	return std::unique_ptr<GShader>(new FanShader(device,localMatrix,mode));
+	return std::unique_ptr<GShader>(new FanShader(device,localMatrix,mode,quality));
 }
 
 std::unique_ptr<GShader> GCreateLinearGradient(GPoint p0, GPoint p1, const GColor* colors, int count, GShader::TileMode mode){
@@ -0,0 +1,99 @@
+#ifndef FanThreadPool_DEFINED
+#define FanThreadPool_DEFINED
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads. run() hands out task indices to the workers and to the
+// calling thread, and returns once every task has finished.
+class FanThreadPool {
+public:
+	// threads counts the calling thread, so threads - 1 workers are started
+	FanThreadPool(int threads) : fTask(nullptr), fCount(0), fNext(0), fDone(0), fQuit(false) {
+		for (int i = 1; i < threads; i++) {
+			fWorkers.push_back(std::thread([this]() { this->loop(); }));
+		}
+	}
+
+	~FanThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			fQuit = true;
+		}
+		fWake.notify_all();
+		for (int i = 0; i < fWorkers.size(); i++) {
+			fWorkers[i].join();
+		}
+	}
+
+	int threadCount() const {
+		return (int)fWorkers.size() + 1;
+	}
+
+	// calls task(i) for every i in [0, count), in no particular order
+	void run(int count, const std::function<void(int)>& task) {
+		if (count <= 0) {
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			fTask = &task;
+			fCount = count;
+			fNext = 0;
+			fDone = 0;
+		}
+		fWake.notify_all();
+
+		std::unique_lock<std::mutex> lock(fMutex);
+		this->work(lock);
+		fFinished.wait(lock, [this]() { return fDone == fCount; });
+		fTask = nullptr;
+		fCount = 0;
+		fNext = 0;
+	}
+
+private:
+	// claims and runs tasks until there are none left; called with the lock held
+	void work(std::unique_lock<std::mutex>& lock) {
+		while (fNext < fCount) {
+			int index = fNext++;
+			const std::function<void(int)>* task = fTask;
+
+			lock.unlock();
+			(*task)(index);
+			lock.lock();
+
+			if (++fDone == fCount) {
+				fFinished.notify_all();
+			}
+		}
+	}
+
+	void loop() {
+		std::unique_lock<std::mutex> lock(fMutex);
+		for (;;) {
+			fWake.wait(lock, [this]() { return fQuit || fNext < fCount; });
+			if (fQuit) {
+				return;
+			}
+			this->work(lock);
+		}
+	}
+
+	std::vector<std::thread> fWorkers;
+	std::mutex fMutex;
+	std::condition_variable fWake;
+	std::condition_variable fFinished;
+
+	const std::function<void(int)>* fTask;
+	int fCount;
+	int fNext;
+	int fDone;
+	bool fQuit;
+};
+
+#endif
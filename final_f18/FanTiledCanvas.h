@@ -0,0 +1,276 @@
+#ifndef FanTiledCanvas_DEFINED
+#define FanTiledCanvas_DEFINED
+
+#include <stack>
+#include <vector>
+#include "include/GCanvas.h"
+#include "include/GBitmap.h"
+#include "include/GPath.h"
+#include "include/GRect.h"
+#include "FanThreadPool.h"
+
+// Expects FanCanvas to be defined by the including file.
+//
+// Splits the device into bands of kBandHeight rows (tiles spanning the full width, since the
+// scan converters work a row at a time). Draws are recorded and binned by the bands their
+// device bounds touch; flush() replays each band's draws in order on the thread pool, through
+// a FanCanvas restricted to the band's rows. Restricting a FanCanvas to some rows never
+// changes the pixels it draws in them, so the result is bit-identical to a single FanCanvas.
+//
+// The caller may destroy a paint's shader as soon as the draw returns, so draws with a shader
+// record a copy of it (GShader::clone()), which every band makes its own contexts from. Shaders
+// that are not copied (ones that only implement setContext() and keep their state in the
+// shader, or bitmaps too big to copy each draw) are drawn immediately on the calling thread,
+// after flushing what is pending.
+class FanTiledCanvas : public GCanvas {
+public:
+	FanTiledCanvas(const GBitmap& device, int threads)
+		: fDevice(device)
+		, fPool(threads)
+		, fBands((device.height() + kBandHeight - 1) / kBandHeight) {
+		CTM_stack.push(GMatrix());
+	}
+
+	~FanTiledCanvas() {
+		this->flush();
+	}
+
+	std::unique_ptr<GShader> final_createRadialGradient(GPoint center, float radius,
+		const GColor colors[], int count, GShader::TileMode mode) override {
+		return std::unique_ptr<GShader>(new RadialShader(center, radius, colors, count, mode));
+	}
+
+	void save() override {
+		GMatrix tmp = CTM_stack.top();
+		CTM_stack.push(tmp);
+	}
+
+	void restore() override {
+		CTM_stack.pop();
+	}
+
+	void concat(const GMatrix& matrix) override {
+		CTM_stack.top().setConcat(CTM_stack.top(), matrix);
+	}
+
+	void drawPaint(const GPaint& paint) override {
+		Op op(Op::kPaint, CTM_stack.top(), paint);
+		this->record(op, 0, fDevice.height());
+	}
+
+	void drawRect(const GRect& rect, const GPaint& paint) override {
+		Op op(Op::kRect, CTM_stack.top(), paint);
+		op.rect = rect;
+		GPoint pts[4] = {
+			GPoint::Make(rect.fLeft, rect.fTop), GPoint::Make(rect.fRight, rect.fTop),
+			GPoint::Make(rect.fRight, rect.fBottom), GPoint::Make(rect.fLeft, rect.fBottom),
+		};
+		this->recordPoints(op, pts, 4);
+	}
+
+	void drawConvexPolygon(const GPoint points[], int count, const GPaint& paint) override {
+		if (count <= 2) {
+			return;
+		}
+		Op op(Op::kPolygon, CTM_stack.top(), paint);
+		op.pts.assign(points, points + count);
+		this->recordPoints(op, points, count);
+	}
+
+	void drawPath(const GPath& path, const GPaint& paint) override {
+		Op op(Op::kPath, CTM_stack.top(), paint);
+		op.path = path;
+		GRect r = path.bounds();
+		GPoint pts[4] = {
+			GPoint::Make(r.fLeft, r.fTop), GPoint::Make(r.fRight, r.fTop),
+			GPoint::Make(r.fRight, r.fBottom), GPoint::Make(r.fLeft, r.fBottom),
+		};
+		this->recordPoints(op, pts, 4);
+	}
+
+	void drawMesh(const GPoint verts[], const GColor colors[], const GPoint texs[], int count,
+		const int indices[], const GPaint& paint) override {
+		if (count <= 0) {
+			return;
+		}
+		Op op(Op::kMesh, CTM_stack.top(), paint);
+		int vertCount = *std::max_element(indices, indices + count * 3) + 1;
+		op.pts.assign(verts, verts + vertCount);
+		if (colors) {
+			op.colors.assign(colors, colors + vertCount);
+		}
+		if (texs) {
+			op.texs.assign(texs, texs + vertCount);
+		}
+		op.indices.assign(indices, indices + count * 3);
+		op.count = count;
+		this->recordPoints(op, verts, vertCount);
+	}
+
+	void drawQuad(const GPoint verts[4], const GColor colors[4], const GPoint texs[4], int level,
+		const GPaint& paint) override {
+		Op op(Op::kQuad, CTM_stack.top(), paint);
+		op.pts.assign(verts, verts + 4);
+		if (colors) {
+			op.colors.assign(colors, colors + 4);
+		}
+		if (texs) {
+			op.texs.assign(texs, texs + 4);
+		}
+		op.level = level;
+		this->recordPoints(op, verts, 4);
+	}
+
+	void drawVertices(const GVertices& vertices, const GPaint& paint) override {
+		if (vertices.triangleCount() <= 0) {
+			return;
+		}
+		// the op shares the vertices' data; nothing is copied
+		Op op(Op::kVertices, CTM_stack.top(), paint);
+		op.vertices = vertices;
+		GRect r = vertices.bounds();
+		GPoint pts[4] = {
+			GPoint::Make(r.fLeft, r.fTop), GPoint::Make(r.fRight, r.fTop),
+			GPoint::Make(r.fRight, r.fBottom), GPoint::Make(r.fLeft, r.fBottom),
+		};
+		this->recordPoints(op, pts, 4);
+	}
+
+	void flush() override {
+		if (fOps.empty()) {
+			return;
+		}
+
+		fPool.run((int)fBands.size(), [this](int band) {
+			FanCanvas canvas(fDevice);
+			canvas.setBand(band * kBandHeight, (band + 1) * kBandHeight);
+			const std::vector<int>& ops = fBands[band];
+			for (int i = 0; i < ops.size(); i++) {
+				replay(&canvas, fOps[ops[i]]);
+			}
+		});
+
+		fOps.clear();
+		for (int i = 0; i < fBands.size(); i++) {
+			fBands[i].clear();
+		}
+	}
+
+private:
+	enum {
+		kBandHeight = 32,
+		kMaxPendingOps = 4096,
+	};
+
+	struct Op {
+		enum Type {
+			kPaint,
+			kRect,
+			kPolygon,
+			kPath,
+			kMesh,
+			kQuad,
+			kVertices,
+		};
+
+		Op(Type type, const GMatrix& ctm, const GPaint& paint)
+			: type(type), ctm(ctm), paint(paint), count(0), level(0) {}
+
+		Type type;
+		GMatrix ctm;
+		GPaint paint;
+		std::shared_ptr<GShader> shader;  // the paint's shader, copied when recorded
+		GRect rect;
+		GPath path;
+		std::vector<GPoint> pts;
+		std::vector<GColor> colors;
+		std::vector<GPoint> texs;
+		std::vector<int> indices;
+		GVertices vertices;
+		int count;
+		int level;
+	};
+
+	static void replay(FanCanvas* canvas, const Op& op) {
+		canvas->setMatrix(op.ctm);
+		switch (op.type) {
+			case Op::kPaint:
+				canvas->drawPaint(op.paint);
+				break;
+			case Op::kRect:
+				canvas->drawRect(op.rect, op.paint);
+				break;
+			case Op::kPolygon:
+				canvas->drawConvexPolygon(op.pts.data(), (int)op.pts.size(), op.paint);
+				break;
+			case Op::kPath:
+				canvas->drawPath(op.path, op.paint);
+				break;
+			case Op::kMesh:
+				canvas->drawMesh(op.pts.data(), op.colors.empty() ? nullptr : op.colors.data(),
+					op.texs.empty() ? nullptr : op.texs.data(), op.count, op.indices.data(), op.paint);
+				break;
+			case Op::kQuad:
+				canvas->drawQuad(op.pts.data(), op.colors.empty() ? nullptr : op.colors.data(),
+					op.texs.empty() ? nullptr : op.texs.data(), op.level, op.paint);
+				break;
+			case Op::kVertices:
+				canvas->drawVertices(op.vertices, op.paint);
+				break;
+		}
+	}
+
+	// bins the op by the device rows covered by the points mapped through its CTM
+	void recordPoints(const Op& op, const GPoint pts[], int count) {
+		float top = op.ctm.mapPt(pts[0]).fY;
+		float bottom = top;
+		for (int i = 1; i < count; i++) {
+			float y = op.ctm.mapPt(pts[i]).fY;
+			top = std::min(top, y);
+			bottom = std::max(bottom, y);
+		}
+		// a pixel of slack for rounding and anti-aliasing
+		this->record(op, GFloorToInt(top) - 1, GCeilToInt(bottom) + 1);
+	}
+
+	void record(const Op& op, int top, int bottom) {
+		top = std::max(0, top);
+		bottom = std::min(fDevice.height(), bottom);
+		if (top >= bottom) {
+			return;
+		}
+
+		std::shared_ptr<GShader> shader;
+		if (op.paint.getShader()) {
+			shader = op.paint.getShader()->clone();
+			if (!shader) {
+				this->flush();
+				FanCanvas canvas(fDevice);
+				replay(&canvas, op);
+				return;
+			}
+		}
+
+		int index = (int)fOps.size();
+		fOps.push_back(op);
+		if (shader) {
+			fOps.back().shader = shader;
+			fOps.back().paint.setShader(shader.get());
+		}
+		for (int band = top / kBandHeight; band <= (bottom - 1) / kBandHeight; band++) {
+			fBands[band].push_back(index);
+		}
+
+		if (fOps.size() >= kMaxPendingOps) {
+			this->flush();
+		}
+	}
+
+	const GBitmap fDevice;
+	FanThreadPool fPool;
+	std::vector<Op> fOps;
+	std::vector<std::vector<int> > fBands;
+	std::stack<GMatrix> CTM_stack;
+};
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef GCoverage_DEFINED
+#define GCoverage_DEFINED
+
+#include <vector>
+#include <algorithm>
+#include "include/GPoint.h"
+#include "include/GMath.h"
+
+// Exact-area coverage for anti-aliased fills.
+//
+// Every line adds its signed area to the cells of an accumulation buffer (one row per
+// scanline, one cell per pixel). A running sum along a row then gives how much of each
+// pixel lies inside the outline; the magnitude is clamped to 1, which matches non-zero
+// winding wherever contours do not overlap with opposite directions.
+class GCoverage {
+public:
+	void reset(int width, int height) {
+		fWidth = width;
+		fHeight = height;
+		fTop = height;
+		fBottom = 0;
+		fLines.clear();
+	}
+
+	// p0 and p1 are in device space. The parts of a line that lie to the left or right of
+	// the device are folded onto x = 0 / x = width, where they still contribute their
+	// winding to the pixels inside.
+	void addLine(GPoint p0, GPoint p1) {
+		if (p0.fY == p1.fY) {
+			return;
+		}
+
+		const float bounds[2] = { 0, (float)fWidth };
+		for (int i = 0; i < 2; i++) {
+			float b = bounds[i];
+			if ((p0.fX < b && p1.fX > b) || (p0.fX > b && p1.fX < b)) {
+				GPoint mid = GPoint::Make(b, p0.fY + (b - p0.fX) * (p1.fY - p0.fY) / (p1.fX - p0.fX));
+				this->addLine(p0, mid);
+				this->addLine(mid, p1);
+				return;
+			}
+		}
+
+		p0.fX = std::max(0.0f, std::min((float)fWidth, p0.fX));
+		p1.fX = std::max(0.0f, std::min((float)fWidth, p1.fX));
+
+		fTop = std::max(0, std::min(fTop, GFloorToInt(std::min(p0.fY, p1.fY))));
+		fBottom = std::min(fHeight, std::max(fBottom, GCeilToInt(std::max(p0.fY, p1.fY))));
+
+		Line line = { p0, p1 };
+		fLines.push_back(line);
+	}
+
+	// Accumulates the lines into the rows [top, bottom) and calls proc(y, x, count, cov[])
+	// for the part of every row the lines touched, with cov[] in 0...255.
+	template <typename RowProc>
+	void resolve(int top, int bottom, RowProc proc) {
+		top = std::max(top, fTop);
+		bottom = std::min(bottom, fBottom);
+		if (top >= bottom) {
+			return;
+		}
+
+		const int stride = fWidth + 2;
+		fAccum.assign((bottom - top) * stride, 0.0f);
+		fRowLeft.assign(bottom - top, stride);
+		fRowRight.assign(bottom - top, 0);
+		fCoverage.resize(fWidth);
+
+		for (int i = 0; i < fLines.size(); i++) {
+			this->accumulate(fLines[i], top, bottom, stride);
+		}
+
+		for (int y = top; y < bottom; ++y) {
+			int left = fRowLeft[y - top];
+			int right = std::min(fWidth, fRowRight[y - top]);
+			if (left >= right) {
+				continue;
+			}
+
+			const float* row = &fAccum[(y - top) * stride];
+			float acc = 0;
+			for (int x = left; x < right; ++x) {
+				acc += row[x];
+				float c = std::min(1.0f, fabsf(acc));
+				fCoverage[x - left] = (uint8_t)(c * 255 + 0.5f);
+			}
+			proc(y, left, right - left, &fCoverage[0]);
+		}
+	}
+
+private:
+	struct Line {
+		GPoint p0;
+		GPoint p1;
+	};
+
+	void accumulate(const Line& line, int top, int bottom, int stride) {
+		GPoint a = line.p0;
+		GPoint b = line.p1;
+		float dir = 1;
+		if (a.fY > b.fY) {
+			std::swap(a, b);
+			dir = -1;
+		}
+
+		const float dxdy = (b.fX - a.fX) / (b.fY - a.fY);
+		int y0 = std::max(top, GFloorToInt(a.fY));
+		int y1 = std::min(bottom, GCeilToInt(b.fY));
+
+		for (int y = y0; y < y1; ++y) {
+			// the piece of the line inside this scanline, computed from the line itself so
+			// that a row's coverage does not depend on which rows were resolved before it
+			float ya = std::max((float)y, a.fY);
+			float yb = std::min((float)(y + 1), b.fY);
+			float dy = yb - ya;
+			if (dy <= 0) {
+				continue;
+			}
+
+			float xa = std::max(0.0f, std::min((float)fWidth, a.fX + (ya - a.fY) * dxdy));
+			float xb = std::max(0.0f, std::min((float)fWidth, a.fX + (yb - a.fY) * dxdy));
+			float x0 = std::min(xa, xb);
+			float x1 = std::max(xa, xb);
+			int x0i = GFloorToInt(x0);
+			int x1i = GCeilToInt(x1);
+			float d = dy * dir;
+
+			float* row = &fAccum[(y - top) * stride];
+			fRowLeft[y - top] = std::min(fRowLeft[y - top], x0i);
+			fRowRight[y - top] = std::max(fRowRight[y - top], x1i + 1);
+
+			if (x1i <= x0i + 1) {
+				// the line stays within one pixel column
+				float xmf = 0.5f * (xa + xb) - x0i;
+				row[x0i] += d - d * xmf;
+				row[x0i + 1] += d * xmf;
+			}
+			else {
+				float s = 1 / (x1 - x0);
+				float x0f = x0 - x0i;
+				float a0 = 0.5f * s * (1 - x0f) * (1 - x0f);
+				float x1f = x1 - x1i + 1;
+				float am = 0.5f * s * x1f * x1f;
+
+				row[x0i] += d * a0;
+				if (x1i == x0i + 2) {
+					row[x0i + 1] += d * (1 - a0 - am);
+				}
+				else {
+					float a1 = s * (1.5f - x0f);
+					row[x0i + 1] += d * (a1 - a0);
+					for (int x = x0i + 2; x < x1i - 1; ++x) {
+						row[x] += d * s;
+					}
+					float a2 = a1 + (x1i - x0i - 3) * s;
+					row[x1i - 1] += d * (1 - a2 - am);
+				}
+				row[x1i] += d * am;
+			}
+		}
+	}
+
+	int fWidth = 0;
+	int fHeight = 0;
+	int fTop = 0;
+	int fBottom = 0;
+	std::vector<Line> fLines;
+	std::vector<float> fAccum;
+	std::vector<int> fRowLeft;
+	std::vector<int> fRowRight;
+	std::vector<uint8_t> fCoverage;
+};
+
+#endif
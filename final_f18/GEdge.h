@@ -1,3 +1,6 @@
+#ifndef GEdge_DEFINED
+#define GEdge_DEFINED
+
 #include "GPoint.h"
 #include <vector>
 #include <algorithm>
@@ -18,6 +21,14 @@ struct GEdge {
 	int y1; //bottom
 	int winding;
 
+	// curr_x and slope in 16.16, set by toFixed() once clipping is done
+	GFixed fixed_x;
+	GFixed fixed_slope;
+
+	// links for the scanline buckets and the active edge list in walkEdges()
+	GEdge* prev;
+	GEdge* next;
+
 	bool init(GPoint p0, GPoint p1) {
 		y0 = GRoundToInt(p0.fY); // assume p0 is the top one
 		y1 = GRoundToInt(p1.fY); // assume p1 is the bottom one
@@ -55,8 +66,17 @@ struct GEdge {
 		curr_x = p_top.fX + dx;
 	}
 
+	void toFixed() {
+		fixed_x = GFloatToFixed(curr_x);
+		fixed_slope = GFloatToFixed(slope);
+	}
+
+	int currentX() const {
+		return GFixedRoundToInt(fixed_x);
+	}
+
 	void updateCurrentX() {
-		curr_x += slope;
+		fixed_x += fixed_slope;
 	}
 };
 
@@ -72,10 +92,10 @@ bool sort_by_yx(GEdge& i, GEdge& j) {
 
 		//std::cout << "y equals to each other" << std::endl;
 
-		if (GRoundToInt(i.curr_x) < GRoundToInt(j.curr_x)) {
+		if (i.currentX() < j.currentX()) {
 			return true;
 		}
-		else if (GRoundToInt(i.curr_x) > GRoundToInt(j.curr_x)) {
+		else if (i.currentX() > j.currentX()) {
 			return false;
 		}
 		else if (i.slope < j.slope) {
@@ -104,15 +124,15 @@ static void storeEdges(const GPoint points[], int count, std::vector<GEdge>& edg
 	}
 }
 
-static void storeEdges(const GPath& path, std::vector<GEdge>& edges, GMatrix& mat) {
+// Maps the path by mat and flattens its curves, calling proc(p0, p1) for every line segment.
+template <typename LineProc>
+static void flattenPath(const GPath& path, const GMatrix& mat, LineProc proc) {
 
 	GPath::Edger edger(path);
 	GPath::Verb v;
 	GPoint points[4];
 	v = edger.next(points);
 
-	GEdge edge;
-
 	/*std::cout <<"0 "<< points[0].fX << ", " << points[0].fY << std::endl;
 	std::cout <<"1 "<< points[1].fX << ", " << points[1].fY << std::endl;*/
 
@@ -142,9 +162,7 @@ static void storeEdges(const GPath& path, std::vector<GEdge>& edges, GMatrix& ma
 				/*std::cout <<"start "<< start.fX << ", " << start.fY << std::endl;
 				std::cout <<"end "<< end.fX << ", " << end.fY << std::endl;*/
 
-				if (edge.init(start, end)) {
-					edges.push_back(edge);		
-				}
+				proc(start, end);
 
 				start = end;
 			}
@@ -167,9 +185,7 @@ static void storeEdges(const GPath& path, std::vector<GEdge>& edges, GMatrix& ma
 
 				end = calc_point_with_t(points[0], points[1], points[2],points[3],t);
 
-				if (edge.init(start, end)) {
-					edges.push_back(edge);
-				}
+				proc(start, end);
 
 				start = end;
 			}
@@ -178,9 +194,7 @@ static void storeEdges(const GPath& path, std::vector<GEdge>& edges, GMatrix& ma
 		}
 		else if (v == GPath::Verb::kLine) {
 			
-			if (edge.init(points[0], points[1])) {
-				edges.push_back(edge);
-			}
+			proc(points[0], points[1]);
 		
 			v=edger.next(points);
 		}
@@ -189,6 +203,16 @@ static void storeEdges(const GPath& path, std::vector<GEdge>& edges, GMatrix& ma
 }
 
 
+static void storeEdges(const GPath& path, std::vector<GEdge>& edges, const GMatrix& mat) {
+	GEdge edge;
+	flattenPath(path, mat, [&](GPoint p0, GPoint p1) {
+		if (edge.init(p0, p1)) {
+			edges.push_back(edge);
+		}
+	});
+}
+
+
 static void sortEdges(std::vector<GEdge>& edges) {
 	for (int i = 0; i < edges.size(); i++) {
 		if (edges[i].y0 == edges[i].y1) {
@@ -199,58 +223,110 @@ static void sortEdges(std::vector<GEdge>& edges) {
 	std::sort(edges.begin(), edges.end(), sort_by_yx);
 }
 
-static void resort_backward(int index, std::vector<GEdge>& edges) {
-	
-	// move edge backwards in the list until the list
-	// is correctly sorted in curr_x
-	// e.g. while (edge->curr_x < prev_edge->curr_x)
-	//          move_edge_to_the_left in the list
-
-	
-	int pre = index - 1;
+static void unlinkEdge(GEdge* edge) {
+	edge->prev->next = edge->next;
+	edge->next->prev = edge->prev;
+}
 
-	/*if (edge->curr_x == 469.5) {
-		std::cout << "edge pre" << pre->p_top.fX << "," << pre->p_top.fY << " " << pre->p_bottom.fX << "," << pre->p_bottom.fY << " curr_x : " << pre->curr_x << std::endl;
-	}*/
+static void insertEdgeBefore(GEdge* edge, GEdge* pos) {
+	edge->prev = pos->prev;
+	edge->next = pos;
+	pos->prev->next = edge;
+	pos->prev = edge;
+}
 
-	while (index>0 && index<edges.size() && edges[index].curr_x < edges[pre].curr_x) {
-		//std::cout << "reach here 0" << std::endl;
-		GEdge tmp= edges[pre];
+// Orders the active list by x. Ties are broken by the edge's address so the order never
+// depends on the rows walked before, which keeps banded rendering identical to a full walk.
+static bool activeBefore(const GEdge* a, const GEdge* b) {
+	return a->fixed_x < b->fixed_x || (a->fixed_x == b->fixed_x && a < b);
+}
 
-		edges[pre] = edges[index];
+// insertion sort on fixed_x; the active list is nearly sorted from the previous
+// scanline, so each edge usually moves zero or one place
+static void resortActive(GEdge* head) {
+	GEdge* edge = head->next->next;
+	while (edge != head) {
+		GEdge* next = edge->next;
+		GEdge* pos = edge->prev;
+		if (activeBefore(edge, pos)) {
+			while (pos->prev != head && activeBefore(edge, pos->prev)) {
+				pos = pos->prev;
+			}
+			unlinkEdge(edge);
+			insertEdgeBefore(edge, pos);
+		}
+		edge = next;
+	}
+}
 
-		edges[index] = tmp;
-		index=pre;
-		pre=index-1;
+// Scan converts the (clipped) edges with non-zero winding over the rows [clipTop, clipBottom).
+// Edges are bucketed by their starting scanline; each scanline the new ones join an active
+// list kept sorted by x, and edges that end leave it in O(1). proc(y, x0, x1) is called for
+// every span.
+template <typename SpanProc>
+static void walkEdges(std::vector<GEdge>& edges, int clipTop, int clipBottom, SpanProc proc) {
+	if (clipTop >= clipBottom) {
+		return;
 	}
 
-	//if (edges.end()->p_top.fX == (edges.end() - 1)->p_top.fX) {
-	//	std::cout << "inside resort :" << std::endl;
-	//	std::cout << "end" << edges.end()->p_top.fX << "," << edges.end()->p_top.fY << " " << edges.end()->p_bottom.fX << "," << edges.end()->p_bottom.fY << " curr_x : " << edges.end()->curr_x << std::endl;
+	std::vector<GEdge*> starts(clipBottom - clipTop, nullptr);
+	int top = clipBottom;
+	int bottom = clipTop;
 
-	//	std::cout << "one before end" << (edges.end() - 1)->p_top.fX << "," << (edges.end() - 1)->p_top.fY << " " << (edges.end() - 1)->p_bottom.fX << "," << (edges.end() - 1)->p_bottom.fY << " curr_x : " << (edges.end() - 1)->curr_x << std::endl;
-	//	std::cout << "current edge" << edge->p_top.fX << "," << edge->p_top.fY << " " << edge->p_bottom.fX << "," << edge->p_bottom.fY << std::endl;
+	for (int i = 0; i < edges.size(); i++) {
+		GEdge* edge = &edges[i];
+		if (edge->y0 >= edge->y1 || edge->y1 <= clipTop || edge->y0 >= clipBottom) {
+			continue;
+		}
+		if (edge->y0 < clipTop) {
+			// jump to the first row of the clip; in fixed point this lands exactly where
+			// stepping row by row would have
+			edge->fixed_x += (GFixed)((int64_t)edge->fixed_slope * (clipTop - edge->y0));
+			edge->y0 = clipTop;
+		}
+		edge->next = starts[edge->y0 - clipTop];
+		starts[edge->y0 - clipTop] = edge;
+		top = std::min(top, edge->y0);
+		bottom = std::max(bottom, std::min(edge->y1, clipBottom));
+	}
 
-	//	for (int i = 0; i < edges.size(); i++) {
-	//		std::cout << "i: " << i << std::endl;
-	//		std::cout << edges[i].p_top.fX << "," << edges[i].p_top.fY << " " << edges[i].p_bottom.fX << "," << edges[i].p_bottom.fY << std::endl;
-	//	}
+	GEdge head;
+	head.prev = head.next = &head;
 
-	//}
+	for (int y = top; y < bottom; ++y) {
+		GEdge* edge = starts[y - clipTop];
+		while (edge) {
+			GEdge* next = edge->next;
+			insertEdgeBefore(edge, &head);
+			edge = next;
+		}
+		resortActive(&head);
 
-	/*std::cout << "after current edge: " << std::endl;
-	std::cout << edge->p_top.fX << "," << edge->p_top.fY << " " << edge->p_bottom.fX << "," << edge->p_bottom.fY << std::endl;
+		int w = 0; //winding accumulator
+		int x0 = 0;
+		for (edge = head.next; edge != &head; ) {
+			if (w == 0) {
+				x0 = edge->currentX();
+			}
 
+			w += edge->winding;
 
-	std::cout << "after resort: " << std::endl;
-	for (int i = 0; i < edges.size(); i++) {
-		std::cout << "i: " << i << std::endl;
-		std::cout << edges[i].p_top.fX << "," << edges[i].p_top.fY << " " << edges[i].p_bottom.fX << "," << edges[i].p_bottom.fY << std::endl;
-	}*/
+			if (w == 0) {
+				proc(y, x0, edge->currentX());
+			}
 
+			GEdge* next = edge->next;
+			if (edge->y1 == y + 1) {
+				unlinkEdge(edge);
+			}
+			else {
+				edge->updateCurrentX();
+			}
+			edge = next;
+		}
+	}
 }
 
-
 static void clipEdges(std::vector<GEdge>& edges, const int height, const int width) {
 	std::vector<GEdge> new_edges;
 
@@ -383,4 +459,10 @@ static void clipEdges(std::vector<GEdge>& edges, const int height, const int wid
 
 	edges.insert(edges.end(), new_edges.begin(), new_edges.end());
 
-}
\ No newline at end of file
+	for (int i = 0; i < edges.size(); i++) {
+		edges[i].toFixed();
+	}
+
+}
+
+#endif
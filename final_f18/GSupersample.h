@@ -0,0 +1,102 @@
+#ifndef GSupersample_DEFINED
+#define GSupersample_DEFINED
+
+#include <vector>
+#include <algorithm>
+#include "GEdge.h"
+
+// Supersampled coverage, the cheaper alternative to GCoverage.
+//
+// The edges are built at (1 << shift) times the device resolution and scan converted with
+// walkEdges(), so every device row is covered by (1 << shift) sub-scanlines with
+// (1 << shift) samples per pixel each. Sub-scanline spans add their horizontal coverage to a
+// run buffer for the current device row, which is resolved once its sub-scanlines are done.
+class GSupersampler {
+public:
+	// Picks the shift for a paint's sample count: 4 -> 2x2, 16 -> 4x4. The edges step x in
+	// 16.16 fixed point, so the supersampled width must stay within kGFixedMaxInt: wider
+	// devices get fewer samples (16 -> 4 past 8191 pixels). Returns 0 if the count does not
+	// ask for supersampling or the device is too wide for it; callers then compute exact
+	// coverage.
+	static int ShiftForSamples(int samples, int width) {
+		int shift = 0;
+		if (samples >= 16) {
+			shift = 2;
+		} else if (samples >= 4) {
+			shift = 1;
+		}
+		while (shift > 0 && (width << shift) > kGFixedMaxInt) {
+			shift -= 1;
+		}
+		return shift;
+	}
+
+	// edges must already be clipped to the supersampled device (height << shift,
+	// width << shift). Calls proc(y, x, count, cov[]) once per device row in [top, bottom),
+	// with cov[] in 0...255.
+	template <typename RowProc>
+	void fill(std::vector<GEdge>& edges, int width, int top, int bottom, int shift, RowProc proc) {
+		const int scale = 1 << shift;
+		const int mask = scale - 1;
+
+		fWidth = width;
+		fRun.assign(width + 1, 0);
+		fCoverage.resize(width + 1);
+		fRowY = -1;
+		fLeft = width;
+		fRight = 0;
+
+		walkEdges(edges, top << shift, bottom << shift, [&](int sy, int sx0, int sx1) {
+			if (sx0 >= sx1) {
+				return;
+			}
+			if ((sy >> shift) != fRowY) {
+				this->flush(shift, proc);
+				fRowY = sy >> shift;
+			}
+
+			int x0 = sx0 >> shift;
+			int x1 = sx1 >> shift;
+			if (x0 == x1) {
+				fRun[x0] += sx1 - sx0;
+			}
+			else {
+				fRun[x0] += scale - (sx0 & mask);
+				for (int x = x0 + 1; x < x1; ++x) {
+					fRun[x] += scale;
+				}
+				fRun[x1] += sx1 & mask;
+			}
+			fLeft = std::min(fLeft, x0);
+			fRight = std::max(fRight, std::min(x1 + 1, width));
+		});
+		this->flush(shift, proc);
+	}
+
+private:
+	template <typename RowProc>
+	void flush(int shift, RowProc& proc) {
+		if (fRowY < 0 || fLeft >= fRight) {
+			return;
+		}
+
+		const int samples = 1 << (2 * shift);
+		for (int x = fLeft; x < fRight; ++x) {
+			fCoverage[x - fLeft] = (uint8_t)((fRun[x] * 255 + samples / 2) >> (2 * shift));
+			fRun[x] = 0;
+		}
+		proc(fRowY, fLeft, fRight - fLeft, &fCoverage[0]);
+
+		fLeft = fWidth;
+		fRight = 0;
+	}
+
+	std::vector<uint16_t> fRun;
+	std::vector<uint8_t> fCoverage;
+	int fWidth;
+	int fRowY;
+	int fLeft;
+	int fRight;
+};
+
+#endif
@@ -1,19 +1,93 @@
-static void clamp(float& x) {
-	x = GPinToUnit(x);
+#ifndef ShadeMode_DEFINED
+#define ShadeMode_DEFINED
+
+#include "include/GMath.h"
+#include "include/GShader.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// The tile modes (GShader::TileMode), as template parameters of the shading loops: each loop is
+// compiled once per mode, so the mode costs nothing per coordinate and the math inlines.
+
+// floorf() for |x| < 2^31 without the library call (the same range GFloorToInt works in)
+static inline float floor_fast(float x) {
+	float t = (float)(int)x;
+	return t > x ? t - 1 : t;
 }
 
-static void repeat(float& x) {
-	x = x - GFloorToInt(x);
+// A coordinate in the unit square's space, tiled into [0, 1].
+template <int Mode>
+static inline float tile_unit(float x) {
+	switch (Mode) {
+		case GShader::kClamp:
+			return GPinToUnit(x);
+		case GShader::kRepeat:
+			return x - floor_fast(x);
+		default:
+			x = x / 2;
+			x -= floor_fast(x);
+			if (x > 0.5) {
+				x = 1 - x;
+			}
+			return x * 2;
+	}
 }
 
-static void mirror(float& x) {
-	x = x / 2;
-	x -= GFloorToInt(x);
-	if (x > 0.5) {
-		x = 1 - x;
+// An integer pixel index, tiled into [0, n), for callers that step in fixed point: mirroring
+// an index reflects it about the edge of the pixel rather than its center. With kPow2 the caller
+// promises n is a power of two, and repeat and mirror mask instead of dividing.
+template <int Mode, bool kPow2>
+static inline int tile_index(int x, int n) {
+	switch (Mode) {
+		case GShader::kClamp:
+			return std::max(0, std::min(n - 1, x));
+		case GShader::kRepeat:
+			if (kPow2) {
+				return x & (n - 1);
+			}
+			x %= n;
+			return x < 0 ? x + n : x;
+		default:
+			if (kPow2) {
+				x &= 2 * n - 1;
+			} else {
+				x %= 2 * n;
+				if (x < 0) {
+					x += 2 * n;
+				}
+			}
+			return x < n ? x : 2 * n - 1 - x;
 	}
-	x = x * 2;
 }
 
+static inline bool is_pow2(int n) {
+	return (n & (n - 1)) == 0;
+}
+
+#if defined(__SSE2__)
+// tile_index for four indices at once; only clamp and the power-of-two cases, which need no
+// division
+template <int Mode>
+static inline __m128i tile_index_x4(__m128i x, int n) {
+	const __m128i last = _mm_set1_epi32(n - 1);
+	switch (Mode) {
+		case GShader::kClamp: {
+			__m128i over = _mm_cmpgt_epi32(x, last);
+			x = _mm_or_si128(_mm_and_si128(over, last), _mm_andnot_si128(over, x));
+			return _mm_andnot_si128(_mm_cmplt_epi32(x, _mm_setzero_si128()), x);
+		}
+		case GShader::kRepeat:
+			return _mm_and_si128(x, last);
+		default: {
+			const __m128i period = _mm_set1_epi32(2 * n - 1);
+			x = _mm_and_si128(x, period);
+			__m128i back = _mm_cmpgt_epi32(x, last);
+			return _mm_or_si128(_mm_and_si128(back, _mm_sub_epi32(period, x)),
+								_mm_andnot_si128(back, x));
+		}
+	}
+}
+#endif
 
-static void(*shadeMode[3])(float& x) = { clamp, repeat, mirror };
\ No newline at end of file
+#endif
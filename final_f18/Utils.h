@@ -53,6 +53,27 @@ static uint32_t quad_div255(uint64_t prod) {
 	return compact(prod);
 }
 
+// 16.16 fixed point, used to step edges without float->int conversions in the scan loops
+typedef int32_t GFixed;
+
+// the largest integer part GFloatToFixed keeps; coordinates past it are clamped
+static const int kGFixedMaxInt = 32767;
+
+static inline GFixed GFloatToFixed(float x) {
+	// keep the integer part within 16 bits so stepping cannot overflow
+	x = std::max(-(float)kGFixedMaxInt, std::min((float)kGFixedMaxInt, x));
+	return (GFixed)floorf(x * 65536 + 0.5f);
+}
+
+static inline int GFixedRoundToInt(GFixed x) {
+	return (x + (1 << 15)) >> 16;
+}
+
+// (a * c + b * (255 - c)) / 255, per component
+static inline GPixel lerp_pixel(GPixel a, GPixel b, unsigned c) {
+	return quad_div255(quad_mul(a, c) + quad_mul(b, 255 - c));
+}
+
 static float calculate_dy(float dx, float slope) {
 	float dy;
 	dy = dx / slope;
@@ -5,6 +5,7 @@
 #include "bench.h"
 #include "GCanvas.h"
 #include "GBitmap.h"
+#include "GCpu.h"
 #include "GTime.h"
 #include <memory>
 #include <string>
@@ -63,11 +64,13 @@ enum Mode {
     kOnce,
 };
 
-static double handle_proc(GBenchmark* bench, const char path[], GBitmap* bitmap, Mode mode) {
+// threads == 0 benches the plain canvas, otherwise the tiled canvas with that many threads
+static double handle_proc(GBenchmark* bench, const char path[], GBitmap* bitmap, Mode mode,
+                          int threads) {
     GISize size = bench->size();
     setup_bitmap(bitmap, size.fWidth, size.fHeight);
 
-    auto canvas = GCreateCanvas(*bitmap);
+    auto canvas = threads > 0 ? GCreateCanvas(*bitmap, threads) : GCreateCanvas(*bitmap);
     if (!canvas) {
         fprintf(stderr, "failed to create canvas for [%d %d] %s\n",
                 size.fWidth, size.fHeight, bench->name());
@@ -86,6 +89,7 @@ static double handle_proc(GBenchmark* bench, const char path[], GBitmap* bitmap,
     for (int i = 0; i < N || forever; ++i) {
         bench->draw(canvas.get());
     }
+    canvas->flush();
     GMSec dur = GTime::GetMSec() - now;
     return dur * 1.0 / N;
 }
@@ -111,6 +115,7 @@ int main(int argc, char** argv) {
     const char* report = NULL;
     const char* author = NULL;
     FILE* reportFile = NULL;
+    int threads = 0;
 
     for (int i = 1; i < argc; ++i) {
         if (is_arg(argv[i], "report") && i+2 < argc) {
@@ -129,9 +134,13 @@ int main(int argc, char** argv) {
             match = argv[++i];
         } else if (is_arg(argv[i], "forever")) {
             mode = kForever;
+        } else if (is_arg(argv[i], "threads") && i+1 < argc) {
+            threads = atoi(argv[++i]);
         }
     }
 
+    printf("cpu: %s\n", GCpuLevelName(GGetCpuLevel()));
+
     for (int i = 0; gBenchFactories[i]; ++i) {
         std::unique_ptr<GBenchmark> bench(gBenchFactories[i]());
         const char* name = bench->name();
@@ -144,10 +153,20 @@ int main(int argc, char** argv) {
         }
         
         GBitmap testBM;
-        double dur = handle_proc(bench.get(), name, &testBM, mode);
+        double dur = handle_proc(bench.get(), name, &testBM, mode, 0);
         printf("bench: %s %g\n", name, dur);
-
         free(testBM.pixels());
+
+        // scaling of the tiled canvas, relative to a single thread
+        double single = 0;
+        for (int t = 1; t <= threads; t *= 2) {
+            double tdur = handle_proc(bench.get(), name, &testBM, mode, t);
+            if (t == 1) {
+                single = tdur;
+            }
+            printf("    threads %2d: %g (x%.2f)\n", t, tdur, tdur > 0 ? single / tdur : 0.0);
+            free(testBM.pixels());
+        }
     }
     return 0;
 }
@@ -6,9 +6,11 @@
 #include "GCanvas.h"
 #include "GBitmap.h"
 #include "GColor.h"
+#include "GPath.h"
 #include "GRandom.h"
 #include "GRect.h"
 #include <string>
+#include <vector>
 
 static GColor rand_color(GRandom& rand, bool forceOpaque = false) {
     GColor c { rand.nextF(), rand.nextF(), rand.nextF(), rand.nextF() };
@@ -109,10 +111,16 @@ static void tesselate_circle(GPoint pts[], int count, float cx, float cy, float
 class CirclesBench : public GBenchmark {
     enum { W = 200, H = 200 };
     const bool fTiny;
+    const bool fAA;
 public:
-    CirclesBench(bool tiny) : fTiny(tiny) {}
+    CirclesBench(bool tiny, bool aa = false) : fTiny(tiny), fAA(aa) {}
     
-    const char* name() const override { return fTiny ? "circles_tiny" : "circles_large"; }
+    const char* name() const override {
+        if (fAA) {
+            return fTiny ? "circles_tiny_aa" : "circles_large_aa";
+        }
+        return fTiny ? "circles_tiny" : "circles_large";
+    }
     GISize size() const override { return { W, H }; }
     void draw(GCanvas* canvas) override {
         GPoint circle[100];
@@ -122,7 +130,9 @@ public:
         const GRect bounds = GRect::MakeLTRB(-10, -10, W + 10, H + 10);
         GRandom rand;
         for (int i = 0; i < N; ++i) {
-            canvas->drawConvexPolygon(circle, 100, GPaint(rand_color(rand, true)));
+            GPaint paint(rand_color(rand, true));
+            paint.setAntiAlias(fAA);
+            canvas->drawConvexPolygon(circle, 100, paint);
         }
     }
 };
@@ -150,6 +160,380 @@ public:
     }
 };
 
+class PathBench : public GBenchmark {
+    enum { W = 200, H = 200 };
+    const int   fEdges;
+    const char* fName;
+public:
+    PathBench(int edges, const char* name) : fEdges(edges), fName(name) {}
+
+    const char* name() const override { return fName; }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        // a star whose points alternate between the inner and outer radius, so every
+        // scanline crosses a large fraction of the edges
+        std::vector<GPoint> pts(fEdges);
+        for (int i = 0; i < fEdges; ++i) {
+            float angle = i * M_PI * 2 / fEdges;
+            float rad = (i & 1) ? 95 : 5;
+            pts[i].set(cos(angle) * rad + 100, sin(angle) * rad + 100);
+        }
+        GPath path;
+        path.addPolygon(pts.data(), fEdges);
+
+        const int N = 10;
+        GRandom rand;
+        for (int i = 0; i < N; ++i) {
+            canvas->drawPath(path, GPaint(rand_color(rand, true)));
+        }
+    }
+};
+
+// The path_1k star filled with a gradient: a thousand short spans per scanline, each one
+// shaded separately.
+class GradientPathBench : public GBenchmark {
+    enum { W = 200, H = 200 };
+public:
+    const char* name() const override { return "path_gradient"; }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        const int edges = 1000;
+        std::vector<GPoint> pts(edges);
+        for (int i = 0; i < edges; ++i) {
+            float angle = i * M_PI * 2 / edges;
+            float rad = (i & 1) ? 95 : 5;
+            pts[i].set(cos(angle) * rad + 100, sin(angle) * rad + 100);
+        }
+        GPath path;
+        path.addPolygon(pts.data(), edges);
+
+        const GColor colors[] = { {1, 1, 0, 0}, {1, 0, 1, 0}, {1, 0, 0, 1} };
+        auto shader = GCreateLinearGradient({0, 0}, {W, H}, colors, 3);
+        GPaint paint(shader.get());
+        for (int i = 0; i < 10; ++i) {
+            canvas->drawPath(path, paint);
+        }
+    }
+};
+
+// Fills the canvas through a rotated shader, so every pixel's local coordinate needs both
+// rows of the inverse matrix.
+class ShaderFillBench : public GBenchmark {
+    enum { W = 512, H = 512 };
+    const bool fBitmap;
+public:
+    ShaderFillBench(bool bitmap) : fBitmap(bitmap) {}
+
+    const char* name() const override { return fBitmap ? "fill_bitmap" : "fill_linear"; }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        std::unique_ptr<GShader> shader;
+        GBitmap bm;
+        if (fBitmap) {
+            bm.alloc(64, 64);
+            GRandom rand;
+            for (int y = 0; y < bm.height(); ++y) {
+                for (int x = 0; x < bm.width(); ++x) {
+                    *bm.getAddr(x, y) = rand.nextU() | 0xFF000000;
+                }
+            }
+            shader = GCreateBitmapShader(bm, GMatrix::MakeScale(3), GShader::kRepeat);
+        } else {
+            const GColor colors[] = { {1, 1, 0, 0}, {1, 0, 1, 0}, {1, 0, 0, 1} };
+            shader = GCreateLinearGradient({0, 0}, {100, 30}, colors, 3, GShader::kMirror);
+        }
+
+        GPaint paint(shader.get());
+        canvas->rotate(0.3f);
+        for (int i = 0; i < 5; ++i) {
+            canvas->drawPaint(paint);
+        }
+        free(bm.pixels());
+    }
+};
+
+// Full-canvas background gradients, straight down or straight across.
+class BackgroundGradientBench : public GBenchmark {
+    enum { W = 1024, H = 1024 };
+    const bool fVertical;
+public:
+    BackgroundGradientBench(bool vertical) : fVertical(vertical) {}
+
+    const char* name() const override { return fVertical ? "background_vertical" : "background_horizontal"; }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        const GColor colors[] = { {1, 0.2f, 0.3f, 0.6f}, {1, 0.9f, 0.9f, 1} };
+        GPoint end = fVertical ? GPoint{0, H} : GPoint{W, 0};
+        auto shader = GCreateLinearGradient({0, 0}, end, colors, 2);
+
+        GPaint paint(shader.get());
+        for (int i = 0; i < 5; ++i) {
+            canvas->drawPaint(paint);
+        }
+    }
+};
+
+// A 2048x2048 canvas filled by the canvas's radial gradient.
+class RadialBench : public GBenchmark {
+    enum { W = 2048, H = 2048 };
+public:
+    const char* name() const override { return "fill_radial"; }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        const GColor colors[] = { {1, 1, 0, 0}, {1, 0, 1, 0}, {1, 0, 0, 1} };
+        auto shader = canvas->final_createRadialGradient({W * 0.4f, H * 0.6f}, W / 3, colors, 3,
+                                                         GShader::kMirror);
+        canvas->drawPaint(GPaint(shader.get()));
+    }
+};
+
+// One 1024x1024 fill through a filtered bitmap shader, so the time is the cost per megapixel.
+// Translate and scale draws take the filter's fast paths, rotate the general one.
+class BitmapFilterBench : public GBenchmark {
+    enum { W = 1024, H = 1024 };
+    const GShader::FilterQuality fQuality;
+    const GMatrix fMatrix;
+    std::string fName;
+public:
+    BitmapFilterBench(GShader::FilterQuality quality, const GMatrix& matrix, const char* name)
+        : fQuality(quality), fMatrix(matrix), fName(name) {}
+
+    const char* name() const override { return fName.c_str(); }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        GBitmap bm;
+        bm.alloc(64, 64);
+        GRandom rand;
+        for (int y = 0; y < bm.height(); ++y) {
+            for (int x = 0; x < bm.width(); ++x) {
+                *bm.getAddr(x, y) = rand.nextU() | 0xFF000000;
+            }
+        }
+        auto shader = GCreateBitmapShader(bm, GMatrix::MakeScale(64), GShader::kRepeat, fQuality);
+
+        canvas->concat(fMatrix);
+        canvas->drawPaint(GPaint(shader.get()));
+        free(bm.pixels());
+    }
+};
+
+// An 8x8 grid of 64x64 thumbnails of one 2048x2048 image. The shaders live as long as the
+// bench, so filtered ones build their mip levels in the first draw and then reuse them.
+class ThumbnailBench : public GBenchmark {
+    enum { W = 512, H = 512, N = 8, kImageSize = 2048 };
+    const GShader::FilterQuality fQuality;
+    GBitmap fImage;
+    std::vector<std::unique_ptr<GShader>> fShaders;
+public:
+    ThumbnailBench(GShader::FilterQuality quality) : fQuality(quality) {}
+    ~ThumbnailBench() override { free(fImage.pixels()); }
+
+    const char* name() const override {
+        return fQuality == GShader::kNearest ? "thumbnails_nearest" : "thumbnails_bilinear";
+    }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        const float cell = W / N;
+        if (fShaders.empty()) {
+            fImage.alloc(kImageSize, kImageSize);
+            GRandom rand;
+            for (int y = 0; y < kImageSize; ++y) {
+                for (int x = 0; x < kImageSize; ++x) {
+                    int a = rand.nextRange(0, 255);
+                    *fImage.getAddr(x, y) = GPixel_PackARGB(a, rand.nextRange(0, a),
+                                                            rand.nextRange(0, a),
+                                                            rand.nextRange(0, a));
+                }
+            }
+            for (int i = 0; i < N * N; ++i) {
+                GMatrix m = GMatrix::MakeTranslate((i % N) * cell, (i / N) * cell);
+                m.preConcat(GMatrix::MakeScale(cell / kImageSize));
+                fShaders.push_back(GCreateBitmapShader(fImage, m, GShader::kClamp, fQuality));
+            }
+        }
+        for (int i = 0; i < N * N; ++i) {
+            GRect r = GRect::MakeXYWH((i % N) * cell, (i / N) * cell, cell, cell);
+            canvas->drawRect(r, GPaint(fShaders[i].get()));
+        }
+    }
+};
+
+// A small corner of a 4096x4096 opaque texture, through a new shader every draw: picking the
+// opaque path must not read the whole texture. Flagged, the bitmap says it is opaque, as
+// readFromFile does; unflagged, its pixels are looked at by the first draw only.
+class TextureBench : public GBenchmark {
+    enum { W = 256, H = 256, kTextureSize = 4096 };
+    const bool fFlagged;
+    GBitmap fTexture;
+public:
+    TextureBench(bool flagged) : fFlagged(flagged) {}
+    ~TextureBench() override { free(fTexture.pixels()); }
+
+    const char* name() const override {
+        return fFlagged ? "texture_4k" : "texture_4k_unflagged";
+    }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        if (!fTexture.pixels()) {
+            fTexture.alloc(kTextureSize, kTextureSize);
+            GRandom rand;
+            for (int y = 0; y < kTextureSize; ++y) {
+                for (int x = 0; x < kTextureSize; ++x) {
+                    *fTexture.getAddr(x, y) = rand.nextU() | 0xFF000000;
+                }
+            }
+            if (fFlagged) {
+                fTexture.setIsOpaque(GBitmap::kCompute_IsOpaque);
+            }
+        }
+        auto shader = GCreateBitmapShader(fTexture, GMatrix());
+        canvas->drawRect(GRect::MakeWH(W, H), GPaint(shader.get()));
+    }
+};
+
+// A finely tessellated quad with colors, and optionally a texture (composed with them): every
+// triangle maps the texture its own way.
+class MeshBench : public GBenchmark {
+    enum { W = 512, H = 512 };
+    const bool fTextured;
+    const int fLevel;
+    const char* fName;
+    GBitmap fTexture;
+    std::unique_ptr<GShader> fShader;
+public:
+    MeshBench(bool textured, int level, const char* name)
+        : fTextured(textured), fLevel(level), fName(name) {}
+    ~MeshBench() override { free(fTexture.pixels()); }
+
+    const char* name() const override { return fName; }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        if (fTextured && !fShader) {
+            fTexture.alloc(64, 64);
+            GRandom rand;
+            for (int y = 0; y < 64; ++y) {
+                for (int x = 0; x < 64; ++x) {
+                    *fTexture.getAddr(x, y) = rand.nextU() | 0xFF000000;
+                }
+            }
+            fShader = GCreateBitmapShader(fTexture, GMatrix(), GShader::kRepeat);
+        }
+        const GPoint verts[] = { { 10, 20 }, { W - 30, 5 }, { W - 10, H - 10 }, { 20, H - 40 } };
+        const GColor colors[] = {
+            { 1, 1, 0, 0 }, { 1, 0, 1, 0 }, { 1, 0, 0, 1 }, { 0.5f, 1, 1, 0 },
+        };
+        const GPoint texs[] = { { 0, 0 }, { 256, 0 }, { 256, 256 }, { 0, 256 } };
+        canvas->drawQuad(verts, colors, fTextured ? texs : nullptr, fLevel,
+                         GPaint(fShader.get()));
+    }
+};
+
+// A colored grid of small triangles, drawn as one frame of an animation would draw it: under a
+// rotated CTM, either from its arrays (drawMesh) or from a GVertices made once (drawVertices).
+class VerticesBench : public GBenchmark {
+    enum { W = 512, H = 512, N = 161 };
+    const bool fReuse;
+    const char* fName;
+    std::vector<GPoint> fVerts;
+    std::vector<GColor> fColors;
+    std::vector<int> fIndices;
+    GVertices fVertices;
+public:
+    VerticesBench(bool reuse, const char* name) : fReuse(reuse), fName(name) {
+        GRandom rand;
+        for (int y = 0; y < N; ++y) {
+            for (int x = 0; x < N; ++x) {
+                fVerts.push_back({ x * 2.5f + rand.nextF(), y * 2.5f + rand.nextF() });
+                fColors.push_back({ 1, rand.nextF(), rand.nextF(), rand.nextF() });
+            }
+        }
+        for (int y = 0; y + 1 < N; ++y) {
+            for (int x = 0; x + 1 < N; ++x) {
+                int i = y * N + x;
+                fIndices.insert(fIndices.end(), { i, i + 1, i + N, i + N + 1, i + 1, i + N });
+            }
+        }
+        fVertices = GVertices::Make(fVerts.data(), fColors.data(), nullptr, N * N,
+                                    fIndices.data(), (int)fIndices.size() / 3);
+    }
+
+    const char* name() const override { return fName; }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        canvas->save();
+        canvas->translate(W / 2, 0);
+        canvas->rotate(0.6f);
+        if (fReuse) {
+            canvas->drawVertices(fVertices, GPaint());
+        } else {
+            canvas->drawMesh(fVerts.data(), fColors.data(), nullptr, (int)fIndices.size() / 3,
+                             fIndices.data(), GPaint());
+        }
+        canvas->restore();
+    }
+};
+
+// Forwards every draw to another canvas, forcing the paint's anti-alias settings.
+class AACanvas : public GCanvas {
+public:
+    AACanvas(GCanvas* proxy, bool aa, int samples) : fProxy(proxy), fAA(aa), fSamples(samples) {}
+
+    void save() override { fProxy->save(); }
+    void restore() override { fProxy->restore(); }
+    void concat(const GMatrix& m) override { fProxy->concat(m); }
+
+    void drawPaint(const GPaint& p) override { fProxy->drawPaint(p); }
+    void drawRect(const GRect& r, const GPaint& p) override { fProxy->drawRect(r, this->aa(p)); }
+    void drawConvexPolygon(const GPoint pts[], int count, const GPaint& p) override {
+        fProxy->drawConvexPolygon(pts, count, this->aa(p));
+    }
+    void drawPath(const GPath& path, const GPaint& p) override {
+        fProxy->drawPath(path, this->aa(p));
+    }
+    void drawMesh(const GPoint verts[], const GColor colors[], const GPoint texs[], int count,
+                  const int indices[], const GPaint& p) override {
+        fProxy->drawMesh(verts, colors, texs, count, indices, p);
+    }
+    void drawQuad(const GPoint verts[4], const GColor colors[4], const GPoint texs[4], int level,
+                  const GPaint& p) override {
+        fProxy->drawQuad(verts, colors, texs, level, p);
+    }
+    void drawVertices(const GVertices& vertices, const GPaint& p) override {
+        fProxy->drawVertices(vertices, p);
+    }
+
+private:
+    GCanvas* fProxy;
+    bool     fAA;
+    int      fSamples;
+
+    GPaint aa(GPaint p) const { return p.setAntiAlias(fAA).setSampleCount(fSamples); }
+};
+
+static void draw_lion(GCanvas* canvas) {
+#include "lion.inc"
+}
+
+class LionBench : public GBenchmark {
+    enum { W = 512, H = 512 };
+    const bool  fAA;
+    const int   fSamples;
+    const char* fName;
+public:
+    LionBench(bool aa, int samples, const char* name) : fAA(aa), fSamples(samples), fName(name) {}
+
+    const char* name() const override { return fName; }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        AACanvas proxy(canvas, fAA, fSamples);
+        proxy.save();
+        proxy.translate(130, 40);
+        proxy.scale(1.2, 1.2);
+        draw_lion(&proxy);
+        proxy.restore();
+    }
+};
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 const GBenchmark::Factory gBenchFactories[] {
@@ -166,9 +550,55 @@ const GBenchmark::Factory gBenchFactories[] {
     []() -> GBenchmark* { return new PolyRectsBench(true);  },
     []() -> GBenchmark* { return new CirclesBench(false); },
     []() -> GBenchmark* { return new CirclesBench(true);  },
+    []() -> GBenchmark* { return new CirclesBench(false, true); },
+    []() -> GBenchmark* { return new CirclesBench(true, true);  },
+    []() -> GBenchmark* { return new LionBench(false, 0, "lion"); },
+    []() -> GBenchmark* { return new LionBench(true, 0, "lion_aa"); },
+    []() -> GBenchmark* { return new LionBench(true, 4, "lion_ss4"); },
+    []() -> GBenchmark* { return new LionBench(true, 16, "lion_ss16"); },
     []() -> GBenchmark* { return new ModesBench({0.0, 1, 0.5, 0.25}, "modes_0"); },
     []() -> GBenchmark* { return new ModesBench({0.5, 1, 0.5, 0.25}, "modes_half"); },
     []() -> GBenchmark* { return new ModesBench({1.0, 1, 0.5, 0.25}, "modes_1"); },
+    []() -> GBenchmark* { return new PathBench(1000, "path_1k"); },
+    []() -> GBenchmark* { return new PathBench(10000, "path_10k"); },
+    []() -> GBenchmark* { return new GradientPathBench; },
+    []() -> GBenchmark* { return new ShaderFillBench(false); },
+    []() -> GBenchmark* { return new ShaderFillBench(true); },
+    []() -> GBenchmark* { return new BackgroundGradientBench(true); },
+    []() -> GBenchmark* { return new BackgroundGradientBench(false); },
+    []() -> GBenchmark* { return new RadialBench; },
+    []() -> GBenchmark* {
+        return new BitmapFilterBench(GShader::kNearest, GMatrix::MakeRotate(0.3f), "filter_nearest_rotate");
+    },
+    []() -> GBenchmark* {
+        return new BitmapFilterBench(GShader::kBilinear, GMatrix::MakeTranslate(0.25f, 0.5f), "filter_bilinear_translate");
+    },
+    []() -> GBenchmark* {
+        return new BitmapFilterBench(GShader::kBilinear, GMatrix::MakeScale(3.3f, 2.1f), "filter_bilinear_scale");
+    },
+    []() -> GBenchmark* {
+        return new BitmapFilterBench(GShader::kBilinear, GMatrix::MakeRotate(0.3f), "filter_bilinear_rotate");
+    },
+    []() -> GBenchmark* {
+        return new BitmapFilterBench(GShader::kBicubic, GMatrix::MakeTranslate(0.25f, 0.5f), "filter_bicubic_translate");
+    },
+    []() -> GBenchmark* {
+        return new BitmapFilterBench(GShader::kBicubic, GMatrix::MakeScale(3.3f, 2.1f), "filter_bicubic_scale");
+    },
+    []() -> GBenchmark* {
+        return new BitmapFilterBench(GShader::kBicubic, GMatrix::MakeRotate(0.3f), "filter_bicubic_rotate");
+    },
+    []() -> GBenchmark* { return new ThumbnailBench(GShader::kNearest); },
+    []() -> GBenchmark* { return new ThumbnailBench(GShader::kBilinear); },
+    []() -> GBenchmark* { return new TextureBench(true); },
+    []() -> GBenchmark* { return new TextureBench(false); },
+    []() -> GBenchmark* { return new MeshBench(true, 24, "mesh_compose"); },
+    []() -> GBenchmark* { return new MeshBench(true, 200, "mesh_texture_80k"); },
+    []() -> GBenchmark* { return new MeshBench(false, 200, "mesh_colors_80k"); },
+    []() -> GBenchmark* { return new MeshBench(false, 500, "mesh_colors_500k"); },
+    []() -> GBenchmark* { return new MeshBench(false, GCanvas::kAutoQuadLevel, "mesh_colors_auto"); },
+    []() -> GBenchmark* { return new VerticesBench(false, "mesh_frame_arrays"); },
+    []() -> GBenchmark* { return new VerticesBench(true, "mesh_frame_vertices"); },
 
     nullptr,
 };
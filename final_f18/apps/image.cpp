@@ -62,10 +62,10 @@ static void setup_bitmap(GBitmap* bitmap, int w, int h) {
     bitmap->reset(w, h, rb, (GPixel*)calloc(h, rb), GBitmap::kNo_IsOpaque);
 }
 
-static void handle_proc(const GDrawRec& rec, const char path[], GBitmap* bitmap) {
+static void handle_proc(const GDrawRec& rec, const char path[], GBitmap* bitmap, int threads) {
     setup_bitmap(bitmap, rec.fWidth, rec.fHeight);
 
-    auto canvas = GCreateCanvas(*bitmap);
+    auto canvas = threads > 0 ? GCreateCanvas(*bitmap, threads) : GCreateCanvas(*bitmap);
     if (!canvas) {
         fprintf(stderr, "failed to create canvas for [%d %d] %s\n",
                 rec.fWidth, rec.fHeight, rec.fName);
@@ -74,6 +74,7 @@ static void handle_proc(const GDrawRec& rec, const char path[], GBitmap* bitmap)
 
     canvas->clear({0, 0, 0, 0});
     rec.fDraw(canvas.get());
+    canvas->flush();
 
     if (!bitmap->writeToFile(path)) {
         fprintf(stderr, "failed to write %s\n", path);
@@ -151,6 +152,7 @@ int main(int argc, char** argv) {
     int tolerance = 0;
     int targetPA = -1;
     int oneShot = -1;
+    int threads = 0;
 
     for (int i = 0; gDrawRecs[i].fDraw; ++i) {
         GASSERT((unsigned)gDrawRecs[i].fPA < GARRAY_COUNT(gPACounts));
@@ -187,6 +189,9 @@ int main(int argc, char** argv) {
             GASSERT(tolerance >= 0);
         } else if (is_arg(argv[i], "scoreFile") && i+1 < argc) {
             scoreFile = argv[++i];
+        } else if (is_arg(argv[i], "threads") && i+1 < argc) {
+            threads = atoi(argv[++i]);
+            GASSERT(threads >= 0);
         } else if (is_arg(argv[i], "diff") && i+1 < argc) {
             diffDir = argv[++i];
             std::string path(diffDir);
@@ -212,6 +217,9 @@ int main(int argc, char** argv) {
         printf("--match %s\n", match);
         printf("--expected %s\n", expected);
         printf("--tolerance %d\n", tolerance);
+        if (threads > 0) {
+            printf("--threads %d\n", threads);
+        }
         if (scoreFile) {
             printf("--scoreFile %s\n", scoreFile);
         }
@@ -250,7 +258,7 @@ int main(int argc, char** argv) {
         }
         
         GBitmap testBM;
-        handle_proc(gDrawRecs[i], path.c_str(), &testBM);
+        handle_proc(gDrawRecs[i], path.c_str(), &testBM, threads);
 
         if (expected && score_me) {
             std::string exp_path(expected);
@@ -5,9 +5,12 @@
 #include "GCanvas.h"
 #include "GBitmap.h"
 #include "GColor.h"
+#include "GPath.h"
 #include "GPoint.h"
 #include "GRect.h"
 #include "tests.h"
+#include "GRandom.h"
+#include "image.h"
 
 static void setup_bitmap(GBitmap* bitmap, int w, int h) {
     size_t rb = w << 2;
@@ -221,6 +224,878 @@ static void test_offscreen_poly(GTestStats* stats) {
     stats->expectTrue(is_filled_with(surface.bitmap(), white), "poly_offscreen");
 }
 
+static void fill_random_premul(const GBitmap& bitmap, GRandom& rand) {
+    for (int y = 0; y < bitmap.height(); ++y) {
+        for (int x = 0; x < bitmap.width(); ++x) {
+            int a = rand.nextRange(0, 255);
+            *bitmap.getAddr(x, y) = GPixel_PackARGB(a, rand.nextRange(0, a), rand.nextRange(0, a),
+                                                    rand.nextRange(0, a));
+        }
+    }
+}
+
+// Anti-aliased coverage is the exact area of each pixel inside the shape: a rect over half of a
+// pixel gives it half alpha, rects that abut inside a pixel add up to full coverage there, and
+// a rect, a polygon and a path of the same shape draw the same pixels. Coverage rounds to the
+// nearest alpha, so a split exactly through the middle of a pixel gives 128 to both sides.
+static void test_aa_coverage(GTestStats* stats) {
+    const GPaint paint = GPaint(GColor::MakeARGB(1, 1, 1, 1)).setAntiAlias(true);
+    auto alpha = [](const GSurface& surface, int x, int y) {
+        return (int)GPixel_GetA(*surface.bitmap().getAddr(x, y));
+    };
+
+    GSurface half(8, 8);
+    half.canvas()->drawRect(GRect::MakeLTRB(2, 2, 2.5f, 3), paint);
+    GSurface quarter(8, 8);
+    quarter.canvas()->drawRect(GRect::MakeLTRB(3.5f, 3.5f, 4, 4), paint);
+    stats->expectTrue(alpha(half, 2, 2) == 128 && alpha(half, 3, 2) == 0 &&
+                      alpha(quarter, 3, 3) == 64, "aa_coverage_area");
+
+    bool sums = true;
+    for (float split : { 10.3f, 10.25f, 10.75f, 10.9f }) {
+        GSurface left(20, 4), right(20, 4);
+        left.canvas()->drawRect(GRect::MakeLTRB(2.2f, 0, split, 4), paint);
+        right.canvas()->drawRect(GRect::MakeLTRB(split, 0, 17.6f, 4), paint);
+        for (int x = 3; x < 17; ++x) {
+            sums &= alpha(left, x, 1) + alpha(right, x, 1) == 255;
+        }
+    }
+    stats->expectTrue(sums, "aa_coverage_abutting");
+
+    bool same = true;
+    const GRect rects[] = {
+        GRect::MakeLTRB(1.3f, 2.7f, 17.6f, 9.2f), GRect::MakeLTRB(4.5f, 0.25f, 5.25f, 15.75f),
+    };
+    for (const GRect& r : rects) {
+        const GPoint pts[] = {
+            { r.fLeft, r.fTop }, { r.fRight, r.fTop }, { r.fRight, r.fBottom }, { r.fLeft, r.fBottom },
+        };
+        GPath path;
+        path.addRect(r);
+        GSurface rect(20, 20), poly(20, 20), drawn(20, 20);
+        rect.canvas()->drawRect(r, paint);
+        poly.canvas()->drawConvexPolygon(pts, 4, paint);
+        drawn.canvas()->drawPath(path, paint);
+        const size_t size = rect.bitmap().rowBytes() * rect.bitmap().height();
+        same &= !memcmp(rect.bitmap().pixels(), poly.bitmap().pixels(), size) &&
+                !memcmp(rect.bitmap().pixels(), drawn.bitmap().pixels(), size);
+    }
+    const GPoint tri[] = { { 2.3f, 1.1f }, { 18.2f, 6.6f }, { 7.7f, 17.4f } };
+    GPath path;
+    path.addPolygon(tri, 3);
+    GSurface poly(20, 20), drawn(20, 20);
+    poly.canvas()->drawConvexPolygon(tri, 3, paint);
+    drawn.canvas()->drawPath(path, paint);
+    same &= !memcmp(poly.bitmap().pixels(), drawn.bitmap().pixels(),
+                    poly.bitmap().rowBytes() * poly.bitmap().height());
+    stats->expectTrue(same, "aa_coverage_shapes");
+}
+
+// Supersampled coverage counts the samples inside the shape: shapes whose edges lie on the
+// sample grid give exact fractions of 255, rounded. 16 samples need the supersampled device to
+// fit 16.16 fixed point, so wider devices fall back to 4 and still draw in the right place.
+static void test_aa_supersample(GTestStats* stats) {
+    auto expected = [](int inside, int samples) {
+        return (inside * 255 + samples / 2) / samples;
+    };
+    auto alpha = [](const GBitmap& bm, int x, int y) {
+        return (int)GPixel_GetA(*bm.getAddr(x, y));
+    };
+
+    bool exact = true;
+    for (int samples : { 4, 16 }) {
+        const float step = samples == 4 ? 0.5f : 0.25f;  // the grid's spacing
+        const int n = samples == 4 ? 2 : 4;              // samples along a side
+        for (int across = 1; across <= n; ++across) {
+            for (int down = 1; down <= n; ++down) {
+                const GRect r = GRect::MakeLTRB(2, 3, 2 + across * step, 3 + down * step);
+                const GPoint pts[] = {
+                    { r.fLeft, r.fTop }, { r.fRight, r.fTop }, { r.fRight, r.fBottom },
+                    { r.fLeft, r.fBottom },
+                };
+                GPath path;
+                path.addRect(r);
+                const GPaint paint = GPaint(GColor::MakeARGB(1, 1, 1, 1)).setAntiAlias(true)
+                                                                          .setSampleCount(samples);
+                GSurface rect(8, 8), poly(8, 8), drawn(8, 8);
+                rect.canvas()->drawRect(r, paint);
+                poly.canvas()->drawConvexPolygon(pts, 4, paint);
+                drawn.canvas()->drawPath(path, paint);
+                const int want = expected(across * down, samples);
+                for (const GSurface* s : { &rect, &poly, &drawn }) {
+                    exact &= alpha(s->bitmap(), 2, 3) == want && alpha(s->bitmap(), 3, 3) == 0 &&
+                             alpha(s->bitmap(), 2, 4) == 0;
+                }
+            }
+        }
+    }
+    stats->expectTrue(exact, "aa_supersample_fractions");
+
+    const int W = 9000;
+    GBitmap wide;
+    wide.alloc(W, 2);
+    const GPaint paint = GPaint(GColor::MakeARGB(1, 1, 1, 1)).setAntiAlias(true)
+                                                              .setSampleCount(16);
+    GCreateCanvas(wide)->drawRect(GRect::MakeLTRB(8000.5f, 0, W - 10, 1), paint);
+    stats->expectTrue(alpha(wide, 7999, 0) == 0 && alpha(wide, 8000, 0) == 128 &&
+                      alpha(wide, 8500, 0) == 255 && alpha(wide, W - 10, 0) == 0,
+                      "aa_supersample_wide");
+    free(wide.pixels());
+}
+
+// A wide rect goes through the vector row blitters; one pixel wide columns only ever hit
+// their scalar tails. Both must produce the same pixels for every mode.
+static void test_blit_row_modes(GTestStats* stats) {
+    const int W = 37, H = 8;
+    GSurface wide(W, H), narrow(W, H);
+    GRandom rand;
+
+    const float alphas[] = { 0, 1, 0.5f, 0.25f, 0.9f };
+    for (int mode = 0; mode <= (int)GBlendMode::kXor; ++mode) {
+        bool same = true;
+        for (int i = 0; i < GARRAY_COUNT(alphas); ++i) {
+            fill_random_premul(wide.bitmap(), rand);
+            memcpy(narrow.bitmap().pixels(), wide.bitmap().pixels(),
+                   wide.bitmap().rowBytes() * H);
+
+            GPaint paint(GColor::MakeARGB(alphas[i], rand.nextF(), rand.nextF(), rand.nextF()));
+            paint.setBlendMode((GBlendMode)mode);
+            wide.canvas()->drawRect(GRect::MakeWH(W, H), paint);
+            for (int x = 0; x < W; ++x) {
+                narrow.canvas()->drawRect(GRect::MakeXYWH(x, 0, 1, H), paint);
+            }
+
+            same &= !memcmp(wide.bitmap().pixels(), narrow.bitmap().pixels(),
+                            wide.bitmap().rowBytes() * H);
+        }
+        stats->expectTrue(same, "blit_row_modes");
+    }
+}
+
+static bool close_pixels(GPixel a, GPixel b, int tolerance) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        if (abs((int)((a >> shift) & 0xFF) - (int)((b >> shift) & 0xFF)) > tolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Horizontal gradients reuse shaded columns across rows, vertical ones shade one pixel per row.
+// A triangle (spans of every width, starting at every x) must still match drawPaint wherever it
+// covers, up to where t rounds to the next table entry.
+static void test_gradient_rows(GTestStats* stats) {
+    const int W = 64, H = 48;
+    const GColor colors[] = { {1, 1, 0, 0}, {1, 0, 1, 0}, {1, 0, 0, 1}, {1, 1, 1, 1} };
+    const GPoint ends[][2] = { { {3, 0}, {60, 0} }, { {0, 40}, {0, 5} } };
+
+    for (auto& end : ends) {
+        GSurface paint(W, H), tri(W, H);
+        auto shader = GCreateLinearGradient(end[0], end[1], colors, 4, GShader::kMirror);
+        paint.canvas()->drawPaint(GPaint(shader.get()));
+
+        const GPoint pts[] = { {W, 0}, {W, H}, {0, H} };
+        tri.canvas()->drawConvexPolygon(pts, 3, GPaint(shader.get()));
+
+        bool same = true;
+        for (int y = 0; y < H; ++y) {
+            for (int x = 0; x < W; ++x) {
+                GPixel p = *tri.bitmap().getAddr(x, y);
+                same &= !p || close_pixels(p, *paint.bitmap().getAddr(x, y), 1);
+            }
+        }
+        stats->expectTrue(same, "gradient_rows");
+    }
+}
+
+// Filtered bitmap shaders: a single-color bitmap stays that color under any matrix, and the
+// translate-only rows (which share x weights) match the general path, reached here through a
+// full turn of rotation, up to rounding.
+static void test_bitmap_filter(GTestStats* stats) {
+    const int W = 29, H = 23;
+    const GShader::FilterQuality qualities[] = { GShader::kBilinear, GShader::kBicubic };
+
+    GBitmap solid, noise;
+    solid.alloc(5, 7);
+    noise.alloc(9, 6);
+    GRandom rand;
+    for (int y = 0; y < solid.height(); ++y) {
+        for (int x = 0; x < solid.width(); ++x) {
+            *solid.getAddr(x, y) = GPixel_PackARGB(200, 150, 20, 99);
+        }
+    }
+    fill_random_premul(noise, rand);
+
+    for (auto quality : qualities) {
+        for (int mode = GShader::kClamp; mode <= GShader::kMirror; ++mode) {
+            GSurface surface(W, H);
+            auto shader = GCreateBitmapShader(solid, GMatrix::MakeScale(1.7f, 0.6f),
+                                              (GShader::TileMode)mode, quality);
+            GPaint paint(shader.get());
+            paint.setBlendMode(GBlendMode::kSrc);
+            surface.canvas()->rotate(0.4f);
+            surface.canvas()->drawPaint(paint);
+            stats->expectTrue(is_filled_with(surface.bitmap(), *solid.getAddr(0, 0)),
+                              "bitmap_filter_solid");
+
+            GSurface translated(W, H), turned(W, H);
+            shader = GCreateBitmapShader(noise, GMatrix::MakeTranslate(0.3f, -2.2f),
+                                         (GShader::TileMode)mode, quality);
+            paint.setShader(shader.get());
+            translated.canvas()->drawPaint(paint);
+            turned.canvas()->rotate(2 * M_PI);
+            turned.canvas()->drawPaint(paint);
+            bool same = true;
+            for (int y = 0; y < H; ++y) {
+                for (int x = 0; x < W; ++x) {
+                    same &= close_pixels(*translated.bitmap().getAddr(x, y),
+                                         *turned.bitmap().getAddr(x, y), 1);
+                }
+            }
+            stats->expectTrue(same, "bitmap_filter_translate");
+        }
+    }
+}
+
+// A one-pixel checkerboard drawn at 1/8 size: filtered shaders read a mip level, so every
+// pixel comes out the average gray instead of an aliased black or white.
+static void test_bitmap_mipmap(GTestStats* stats) {
+    GBitmap checker;
+    checker.alloc(64, 64);
+    for (int y = 0; y < checker.height(); ++y) {
+        for (int x = 0; x < checker.width(); ++x) {
+            *checker.getAddr(x, y) = ((x ^ y) & 1) ? 0xFFFFFFFF : 0xFF000000;
+        }
+    }
+
+    const GShader::FilterQuality qualities[] = { GShader::kBilinear, GShader::kBicubic };
+    for (auto quality : qualities) {
+        GSurface surface(8, 8);
+        auto shader = GCreateBitmapShader(checker, GMatrix::MakeScale(0.125f), GShader::kRepeat,
+                                          quality);
+        surface.canvas()->rotate(0.2f);
+        surface.canvas()->drawPaint(GPaint(shader.get()));
+
+        bool gray = true;
+        for (int y = 0; y < 8; ++y) {
+            for (int x = 0; x < 8; ++x) {
+                gray &= close_pixels(*surface.bitmap().getAddr(x, y), 0xFF808080, 4);
+            }
+        }
+        stats->expectTrue(gray, "bitmap_mipmap");
+    }
+    free(checker.pixels());
+}
+
+static int tile_ref(int x, int n, int mode) {
+    switch (mode) {
+        case GShader::kClamp:
+            return std::max(0, std::min(n - 1, x));
+        case GShader::kRepeat:
+            return (x % n + n) % n;
+        default: {
+            int m = (x % (2 * n) + 2 * n) % (2 * n);
+            return m < n ? m : 2 * n - 1 - m;
+        }
+    }
+}
+
+// Nearest sampling with every pixel center in the middle of a texel (whole translations, quarter
+// turns), checked against tiling by hand: power-of-two and other sizes, rows and columns.
+static void test_bitmap_tiling(GTestStats* stats) {
+    const int W = 40, H = 40;
+    const GMatrix ctms[] = {
+        GMatrix(),
+        GMatrix::MakeTranslate(W / 2, H / 2).preConcat(GMatrix::MakeRotate(M_PI / 2)),
+    };
+    const GISize sizes[] = { { 16, 8 }, { 12, 6 } };
+
+    GRandom rand;
+    for (auto size : sizes) {
+        GBitmap bm;
+        bm.alloc(size.fWidth, size.fHeight);
+        fill_random_premul(bm, rand);
+        const GMatrix local = GMatrix::MakeTranslate(-37, 21);
+
+        for (int mode = GShader::kClamp; mode <= GShader::kMirror; ++mode) {
+            bool same = true;
+            for (const GMatrix& ctm : ctms) {
+                GSurface surface(W, H);
+                auto shader = GCreateBitmapShader(bm, local, (GShader::TileMode)mode);
+                GPaint paint(shader.get());
+                paint.setBlendMode(GBlendMode::kSrc);
+                surface.canvas()->concat(ctm);
+                surface.canvas()->drawPaint(paint);
+
+                GMatrix inverse, full;
+                full.setConcat(ctm, local);
+                full.invert(&inverse);
+                for (int y = 0; y < H; ++y) {
+                    for (int x = 0; x < W; ++x) {
+                        GPoint p = inverse.mapXY(x + 0.5f, y + 0.5f);
+                        GPixel expected = *bm.getAddr(tile_ref(GFloorToInt(p.fX), bm.width(), mode),
+                                                      tile_ref(GFloorToInt(p.fY), bm.height(), mode));
+                        same &= *surface.bitmap().getAddr(x, y) == expected;
+                    }
+                }
+            }
+            stats->expectTrue(same, "bitmap_tiling");
+        }
+        free(bm.pixels());
+    }
+}
+
+// Rows whose texel coordinates do not fit in 16.16 are stepped in float. Far past the right and
+// bottom edges a clamped coordinate tiles to exactly 1, which must still read the last texel.
+static void test_bitmap_float_clamp(GTestStats* stats) {
+    GBitmap bm;
+    bm.alloc(4, 4);
+    for (int y = 0; y < bm.height(); ++y) {
+        for (int x = 0; x < bm.width(); ++x) {
+            *bm.getAddr(x, y) = GPixel_PackARGB(0xFF, x * 60, y * 60, 0);
+        }
+    }
+    auto shader = GCreateBitmapShader(bm, GMatrix::MakeScale(0.0001f));
+    GSurface surface(16, 16);
+    surface.canvas()->drawPaint(GPaint(shader.get()));
+    bool same = true;
+    for (int y = 0; y < 16; ++y) {
+        for (int x = 0; x < 16; ++x) {
+            same &= *surface.bitmap().getAddr(x, y) == *bm.getAddr(3, 3);
+        }
+    }
+    stats->expectTrue(same, "bitmap_float_clamp");
+    free(bm.pixels());
+}
+
+static void test_bitmap_shader_opaque(GTestStats* stats) {
+    GBitmap bm;
+    bm.alloc(7, 5);
+    for (int y = 0; y < bm.height(); ++y) {
+        for (int x = 0; x < bm.width(); ++x) {
+            *bm.getAddr(x, y) = GPixel_PackARGB(0xFF, x * 30, y * 40, 0);
+        }
+    }
+    auto shader = GCreateBitmapShader(bm, GMatrix());
+    stats->expectTrue(shader->isOpaque(), "bitmap_shader_opaque");
+    bm.setIsOpaque(GBitmap::kCompute_IsOpaque);
+    stats->expectTrue(GCreateBitmapShader(bm, GMatrix())->isOpaque(), "bitmap_shader_opaque_flag");
+
+    // shaders of the same generation share what they found; a new generation looks again, even
+    // while a shader of the old one is alive
+    bm.setIsOpaque(GBitmap::kNo_IsOpaque);
+    *bm.getAddr(6, 4) = GPixel_PackARGB(0x80, 0, 0, 0);
+    stats->expectTrue(GCreateBitmapShader(bm, GMatrix::MakeScale(2))->isOpaque(),
+                      "bitmap_shader_opaque_same_generation");
+    bm.notifyPixelsChanged();
+    stats->expectFalse(GCreateBitmapShader(bm, GMatrix())->isOpaque(), "bitmap_shader_not_opaque");
+    free(bm.pixels());
+
+    // the same for mip levels: a minified draw of white pixels builds them, then the pixels
+    // turn black while that shader is still alive
+    GBitmap big;
+    big.alloc(64, 64);
+    auto fill_and_draw = [&big](GPixel color) {
+        for (int y = 0; y < big.height(); ++y) {
+            for (int x = 0; x < big.width(); ++x) {
+                *big.getAddr(x, y) = color;
+            }
+        }
+        big.notifyPixelsChanged();
+        auto shader = GCreateBitmapShader(big, GMatrix::MakeScale(0.125f), GShader::kRepeat,
+                                          GShader::kBilinear);
+        GSurface surface(8, 8);
+        surface.canvas()->drawPaint(GPaint(shader.get()));
+        return std::make_pair(std::move(shader), *surface.bitmap().getAddr(3, 3));
+    };
+    auto white = fill_and_draw(0xFFFFFFFF);
+    auto black = fill_and_draw(0xFF000000);
+    stats->expectTrue(white.second == 0xFFFFFFFF && black.second == 0xFF000000,
+                      "bitmap_shader_fresh_mips");
+    free(big.pixels());
+}
+
+// A context pointed at another CTM shades what a context made for it does: for every kind of
+// shader, including a minified filtered bitmap that needs another mip level, and a matrix that
+// cannot be inverted in between.
+static void test_context_set_ctm(GTestStats* stats) {
+    const int W = 40, H = 8;
+    GBitmap bm;
+    bm.alloc(32, 32);
+    GRandom rand;
+    for (int y = 0; y < bm.height(); ++y) {
+        for (int x = 0; x < bm.width(); ++x) {
+            *bm.getAddr(x, y) = rand.nextU() | 0xFF000000;
+        }
+    }
+    const GColor colors[] = { { 1, 1, 0, 0 }, { 0.5f, 0, 1, 0 }, { 1, 0, 0, 1 } };
+    GSurface surface(W, H);
+
+    std::vector<std::unique_ptr<GShader>> shaders;
+    const GMatrix local = GMatrix::MakeScale(0.5f);
+    for (auto mode : { GShader::kClamp, GShader::kRepeat, GShader::kMirror }) {
+        for (auto quality : { GShader::kNearest, GShader::kBilinear, GShader::kBicubic }) {
+            shaders.push_back(GCreateBitmapShader(bm, local, mode, quality));
+        }
+        shaders.push_back(GCreateLinearGradient({ 2, 3 }, { 30, 7 }, colors, 3, mode));
+        shaders.push_back(GCreateLinearGradient({ 2, 3 }, { 30, 3 }, colors, 3, mode));
+        shaders.push_back(surface.canvas()->final_createRadialGradient({ 20, 4 }, 15, colors, 3,
+                                                                       mode));
+    }
+    shaders.push_back(GCreateLinearGradient({ 2, 3 }, { 30, 7 }, colors, 1));
+
+    GMatrix rotated = GMatrix::MakeRotate(0.3f);
+    rotated.postConcat(GMatrix::MakeScale(0.2f, 0.3f));
+    rotated.postConcat(GMatrix::MakeTranslate(5, 1));
+    const GMatrix matrices[] = {
+        GMatrix::MakeScale(2), rotated, GMatrix(3, 0, 7, 0, 0.5f, -2), GMatrix::MakeScale(2),
+    };
+    const GMatrix singular = GMatrix::MakeScale(0, 1);
+
+    bool same = true;
+    for (auto& shader : shaders) {
+        auto moved = shader->makeContext(matrices[0]);
+        GPixel expected[W], actual[W];
+        for (int i = 1; i < 4; ++i) {
+            for (int y = 0; y < H; ++y) {
+                moved->shadeRow(0, y, W, actual);  // fills any caches with rows for the last one
+            }
+            moved->setCTM(singular);
+            same &= moved->setCTM(matrices[i]);
+            auto fresh = shader->makeContext(matrices[i]);
+            for (int y = 0; y < H; ++y) {
+                fresh->shadeRow(0, y, W, expected);
+                moved->shadeRow(0, y, W, actual);
+                same &= std::equal(expected, expected + W, actual);
+            }
+        }
+    }
+    stats->expectTrue(same, "context_set_ctm");
+    free(bm.pixels());
+}
+
+// Edges that end exactly on the right edge of the device give empty spans at x == width on
+// some rows; they must draw nothing rather than address the pixel past the row (which asserts
+// in debug builds). Every path, polygon and mesh whose edge lies on the right edge still fills
+// the last column.
+static void test_span_at_width(GTestStats* stats) {
+    const int W = 64, H = 64;
+    // a wedge whose tips round to the right edge
+    const GPoint pts[] = { { W, 0 }, { W, H }, { W - 20.3f, H * 0.5f } };
+    GPath path;
+    path.addPolygon(pts, 3);
+    const GColor white = { 1, 1, 1, 1 };
+    const GColor colors[] = { white, white, white };
+    const int indices[] = { 0, 1, 2 };
+
+    GBitmap tex;
+    tex.alloc(1, 1);
+    *tex.getAddr(0, 0) = GPixel_PackARGB(0xFF, 0xFF, 0xFF, 0xFF);
+    auto shader = GCreateBitmapShader(tex, GMatrix());
+
+    for (GShader* s : { (GShader*)nullptr, shader.get() }) {
+        for (int draw = 0; draw < 3; ++draw) {
+            GSurface surface(W, H);
+            surface.canvas()->clear(GColor());
+            GPaint paint(white);
+            paint.setShader(s);
+            if (draw == 0) {
+                surface.canvas()->drawPath(path, paint);
+            } else if (draw == 1) {
+                surface.canvas()->drawConvexPolygon(pts, 3, paint);
+            } else {
+                surface.canvas()->drawMesh(pts, colors, nullptr, 1, indices, paint);
+            }
+            bool filled = true;
+            for (int y = 1; y < H - 1; ++y) {
+                filled &= *surface.bitmap().getAddr(W - 1, y) != 0;
+            }
+            stats->expectTrue(filled, "span_at_width");
+        }
+    }
+    free(tex.pixels());
+}
+
+// A mesh with colors and texture coordinates composes two shaders per row, through rows the
+// canvas lends it; drawing it twice checks that the rows are given back.
+static void test_mesh_compose_wide(GTestStats* stats) {
+    const int W = 30000, H = 2;
+    GBitmap device;
+    device.alloc(W, H);
+    memset(device.pixels(), 0, device.rowBytes() * H);
+
+    GBitmap tex;
+    tex.alloc(1, 1);
+    *tex.getAddr(0, 0) = GPixel_PackARGB(0xFF, 0xFF, 0xFF, 0xFF);
+    auto shader = GCreateBitmapShader(tex, GMatrix());
+
+    const GPoint verts[] = { { 0, 0 }, { W, 0 }, { W, H }, { 0, H } };
+    const GColor colors[] = { { 1, 1, 0, 0 }, { 1, 1, 0, 0 }, { 1, 1, 0, 0 }, { 1, 1, 0, 0 } };
+    const GPoint texs[] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+    const int indices[] = { 0, 1, 2, 0, 2, 3 };
+    GPaint paint(shader.get());
+    paint.setBlendMode(GBlendMode::kSrc);
+    auto canvas = GCreateCanvas(device);
+    canvas->drawMesh(verts, colors, texs, 2, indices, paint);
+    canvas->drawMesh(verts, colors, texs, 2, indices, paint);
+
+    const GPixel red = GPixel_PackARGB(0xFF, 0xFF, 0, 0);
+    stats->expectTrue(*device.getAddr(0, 0) == red && *device.getAddr(W / 2, 1) == red &&
+                      *device.getAddr(W - 1, 1) == red, "mesh_compose_wide");
+    free(device.pixels());
+    free(tex.pixels());
+}
+
+// Where the center of pixel (x, y) is relative to a convex polygon: 1 inside, -1 outside, or 0
+// if it is too close to an edge to tell (where rounding may settle it either way).
+static int center_side(const GPoint pts[], int count, int x, int y) {
+    double area = 0;
+    for (int i = 0; i < count; ++i) {
+        const GPoint& p0 = pts[i];
+        const GPoint& p1 = pts[(i + 1) % count];
+        area += (double)p0.fX * p1.fY - (double)p1.fX * p0.fY;
+    }
+    int side = 1;
+    for (int i = 0; i < count; ++i) {
+        const GPoint& p0 = pts[i];
+        const GPoint& p1 = pts[(i + 1) % count];
+        double ex = p1.fX - p0.fX, ey = p1.fY - p0.fY;
+        double d = (ex * (y + 0.5 - p0.fY) - ey * (x + 0.5 - p0.fX)) / sqrt(ex * ex + ey * ey);
+        d = area > 0 ? d : -d;
+        if (d < -1e-2) {
+            return -1;
+        }
+        if (d < 1e-2) {
+            side = 0;
+        }
+    }
+    return side;
+}
+
+// drawMesh scan converts its triangles itself: a pixel is drawn when its center is inside the
+// triangle, also for triangles that hang off the device.
+static void test_mesh_coverage(GTestStats* stats) {
+    const int W = 80, H = 60;
+    GRandom rand;
+    bool same = true;
+    for (int n = 0; n < 200; ++n) {
+        GPoint pts[3];
+        for (auto& p : pts) {
+            p = { rand.nextF() * (W + 40) - 20, rand.nextF() * (H + 40) - 20 };
+        }
+        const GColor color = { 1, 1, 1, 1 };
+        const GColor colors[] = { color, color, color };
+        const int indices[] = { 0, 1, 2 };
+
+        GSurface mesh(W, H);
+        mesh.canvas()->clear(GColor());
+        mesh.canvas()->drawMesh(pts, colors, nullptr, 1, indices, GPaint());
+        for (int y = 0; y < H; ++y) {
+            for (int x = 0; x < W; ++x) {
+                int side = center_side(pts, 3, x, y);
+                same &= side == 0 || (*mesh.bitmap().getAddr(x, y) != 0) == (side > 0);
+            }
+        }
+    }
+    stats->expectTrue(same, "mesh_coverage");
+}
+
+// The triangles of a mesh share their edges, and each pixel along one belongs to exactly one
+// of them. Every triangle of a dense drawQuad grid adds 1 to the alpha of the pixels it covers,
+// so the sum in each pixel must be 1 inside the quad and 0 outside: no seams, no overlaps. The
+// last quad puts every vertex on a pixel center, so centers fall exactly on the edges, and
+// level 500 (half a million triangles) checks that big tessellations stay off the stack.
+static void test_mesh_watertight(GTestStats* stats) {
+    const int W = 128, H = 128;
+    const GPoint quads[][4] = {
+        { { 3.3f, 7.9f }, { 120.2f, 1.1f }, { 110.7f, 125.4f }, { 9.6f, 101.3f } },
+        { { 60.1f, 2.2f }, { 126.8f, 64.3f }, { 63.9f, 120.6f }, { 1.4f, 60.7f } },
+        { { 0.5f, 0.5f }, { 120.5f, 0.5f }, { 120.5f, 120.5f }, { 0.5f, 120.5f } },
+    };
+    const GColor one = { 1.0f / 255, 0, 0, 0 };
+    const GColor colors[] = { one, one, one, one };
+
+    for (auto& quad : quads) {
+        for (int level : { 7, 40, 119, 500 }) {
+            GSurface surface(W, H);
+            surface.canvas()->clear(GColor());
+            surface.canvas()->drawQuad(quad, colors, nullptr, level, GPaint());
+
+            int inside = 0, sum = 0;
+            bool exact = true;
+            for (int y = 0; y < H; ++y) {
+                for (int x = 0; x < W; ++x) {
+                    int layers = GPixel_GetA(*surface.bitmap().getAddr(x, y));
+                    int side = center_side(quad, 4, x, y);
+                    sum += layers;
+                    inside += side > 0;
+                    exact &= layers <= 1 && (side == 0 || layers == (side > 0));
+                }
+            }
+            stats->expectTrue(exact && sum >= inside, "mesh_watertight");
+        }
+    }
+}
+
+// The largest difference in any component of a pixel whose center is clearly inside or outside
+// the convex polygon pts (along the edges, rounding may settle coverage either way).
+static int max_pixel_diff(const GBitmap& a, const GBitmap& b, const GPoint pts[], int count) {
+    int diff = 0;
+    for (int y = 0; y < a.height(); ++y) {
+        for (int x = 0; x < a.width(); ++x) {
+            if (center_side(pts, count, x, y) == 0) {
+                continue;
+            }
+            GPixel p = *a.getAddr(x, y), q = *b.getAddr(x, y);
+            for (int shift = 0; shift < 32; shift += 8) {
+                int pc = (p >> shift) & 0xFF, qc = (q >> shift) & 0xFF;
+                diff = std::max(diff, std::abs(pc - qc));
+            }
+        }
+    }
+    return diff;
+}
+
+// kAutoQuadLevel tessellates a quad only as finely as it needs on the device: a flat
+// parallelogram is two triangles, and a warped one, large or shrunk by the CTM, stays within a
+// step or two of a very fine tessellation.
+static void test_quad_auto_level(GTestStats* stats) {
+    const int W = 128, H = 128;
+    const GPoint flat[] = { { 10, 10 }, { 110, 20 }, { 100, 120 }, { 0, 110 } };
+    const GColor red = { 1, 1, 0, 0 };
+    const GColor reds[] = { red, red, red, red };
+    GSurface coarse(W, H), autoLevel(W, H);
+    coarse.canvas()->clear(GColor());
+    coarse.canvas()->drawQuad(flat, reds, nullptr, 0, GPaint());
+    autoLevel.canvas()->clear(GColor());
+    autoLevel.canvas()->drawQuad(flat, reds, nullptr, GCanvas::kAutoQuadLevel, GPaint());
+    stats->expectTrue(max_pixel_diff(coarse.bitmap(), autoLevel.bitmap(), flat, 4) == 0,
+                      "quad_auto_flat");
+
+    const GPoint warped[] = { { 40, 10 }, { 80, 6 }, { 126, 120 }, { 2, 124 } };
+    const GColor colors[] = { { 1, 1, 0, 0 }, { 1, 0, 1, 0 }, { 1, 0, 0, 1 }, { 1, 1, 1, 1 } };
+    for (float scale : { 1.0f, 0.1f }) {
+        GSurface fine(W, H);
+        GPoint device[4];
+        GMatrix::MakeScale(scale).mapPoints(device, warped, 4);
+        fine.canvas()->clear(GColor());
+        fine.canvas()->concat(GMatrix::MakeScale(scale));
+        fine.canvas()->drawQuad(warped, colors, nullptr, 200, GPaint());
+        autoLevel.canvas()->clear(GColor());
+        autoLevel.canvas()->save();
+        autoLevel.canvas()->concat(GMatrix::MakeScale(scale));
+        autoLevel.canvas()->drawQuad(warped, colors, nullptr, GCanvas::kAutoQuadLevel, GPaint());
+        autoLevel.canvas()->restore();
+        stats->expectTrue(max_pixel_diff(fine.bitmap(), autoLevel.bitmap(), device, 4) <= 2,
+                          "quad_auto_warped");
+    }
+}
+
+// drawVertices draws what drawMesh draws with the same arrays (the colors may round a step
+// apart, as they are stepped from a different setup), on the threaded canvas too. A GVertices
+// keeps its own copy of the arrays, and drops the triangles that have no area.
+static void test_draw_vertices(GTestStats* stats) {
+    const int W = 96, H = 96, N = 7;
+    GPoint verts[N * N], texs[N * N];
+    GColor colors[N * N];
+    GRandom rand;
+    for (int i = 0; i < N * N; ++i) {
+        verts[i] = { (i % N) * 16.0f + rand.nextF() * 6, (i / N) * 16.0f + rand.nextF() * 6 };
+        texs[i] = { rand.nextF() * 8, rand.nextF() * 8 };
+        colors[i] = { 0.5f + rand.nextF() / 2, rand.nextF(), rand.nextF(), rand.nextF() };
+    }
+    std::vector<int> indices;
+    for (int y = 0; y + 1 < N; ++y) {
+        for (int x = 0; x + 1 < N; ++x) {
+            int i = y * N + x;
+            indices.insert(indices.end(), { i, i + 1, i + N, i + N + 1, i + 1, i + N });
+        }
+    }
+    // no area
+    indices.insert(indices.end(), { 0, 1, 1 });
+    const int count = (int)indices.size() / 3;
+    GVertices vertices = GVertices::Make(verts, colors, texs, N * N, indices.data(), count);
+    stats->expectTrue(vertices.triangleCount() == count - 1, "vertices_no_area");
+
+    GBitmap tex;
+    tex.alloc(4, 4);
+    for (int i = 0; i < 16; ++i) {
+        *tex.getAddr(i % 4, i / 4) = GPixel_PackARGB(0xFF, i * 16, 255 - i * 16, i & 1 ? 255 : 0);
+    }
+    auto shader = GCreateBitmapShader(tex, GMatrix(), GShader::kRepeat);
+
+    GMatrix ctm;
+    ctm.setRotate(0.3f);
+    ctm.postTranslate(20, -10);
+    const GPoint device[] = { { -1, -1 }, { W + 1, -1 }, { W + 1, H + 1 }, { -1, H + 1 } };
+    for (GShader* s : { (GShader*)nullptr, shader.get() }) {
+        GSurface mesh(W, H), drawn(W, H);
+        mesh.canvas()->clear(GColor());
+        mesh.canvas()->concat(ctm);
+        mesh.canvas()->drawMesh(verts, colors, s ? texs : nullptr, count, indices.data(),
+                                GPaint(s));
+        // the arrays may change once the vertices are made
+        std::swap(verts[0], verts[N * N - 1]);
+        drawn.canvas()->clear(GColor());
+        drawn.canvas()->concat(ctm);
+        drawn.canvas()->drawVertices(vertices, GPaint(s));
+        std::swap(verts[0], verts[N * N - 1]);
+        stats->expectTrue(max_pixel_diff(mesh.bitmap(), drawn.bitmap(), device, 4) <= 1,
+                          "vertices_match_mesh");
+    }
+
+    GSurface mesh(W, H);
+    GBitmap tiled;
+    tiled.alloc(W, H);
+    auto canvas = GCreateCanvas(tiled, 3);
+    for (GCanvas* c : { mesh.canvas(), canvas.get() }) {
+        c->clear(GColor());
+        c->concat(ctm);
+        c->drawVertices(vertices, GPaint());
+        c->flush();
+    }
+    stats->expectTrue(max_pixel_diff(mesh.bitmap(), tiled, device, 4) == 0, "vertices_threaded");
+    free(tiled.pixels());
+    free(tex.pixels());
+}
+
+// A triangle whose texture coordinates have no area has no texture mapped onto it: drawn with
+// a shader it draws nothing, without one it draws its colors, as texs are then ignored. The
+// GVertices keeps it, and drawVertices decides per draw the way drawMesh does, anti-aliased too
+// (the colors may round a step apart, as in test_draw_vertices).
+static void test_vertices_degenerate_texs(GTestStats* stats) {
+    const int W = 32, H = 16;
+    const GPoint verts[] = { { 1, 1 }, { 15, 1 }, { 1, 15 }, { 17, 1 }, { 31, 1 }, { 17, 15 } };
+    const GColor colors[6] = {
+        { 1, 1, 0, 0 }, { 1, 0, 1, 0 }, { 1, 0, 0, 1 }, { 1, 1, 0, 0 }, { 1, 0, 1, 0 },
+        { 1, 0, 0, 1 },
+    };
+    // the first triangle's texture coordinates lie on a line
+    const GPoint texs[] = { { 0, 0 }, { 2, 2 }, { 4, 4 }, { 0, 0 }, { 4, 0 }, { 0, 4 } };
+    const int indices[] = { 0, 1, 2, 3, 4, 5 };
+    const GPoint device[] = { { -1, -1 }, { W + 1, -1 }, { W + 1, H + 1 }, { -1, H + 1 } };
+
+    GBitmap tex;
+    tex.alloc(4, 4);
+    for (int i = 0; i < 16; ++i) {
+        *tex.getAddr(i % 4, i / 4) = GPixel_PackARGB(0xFF, i * 16, 255 - i * 16, 0x80);
+    }
+    auto shader = GCreateBitmapShader(tex, GMatrix(), GShader::kRepeat);
+
+    bool kept = true, match = true, drawsColors = true, drawsNothing = true;
+    for (const GColor* c : { colors, (const GColor*)nullptr }) {
+        GVertices vertices = GVertices::Make(verts, c, texs, 6, indices, 2);
+        kept &= vertices.triangleCount() == 2 && !vertices.texMatrixIsValid(0) &&
+                vertices.texMatrixIsValid(1);
+        for (GShader* s : { (GShader*)nullptr, shader.get() }) {
+            for (bool aa : { false, true }) {
+                GPaint paint(s);
+                paint.setAntiAlias(aa);
+                GSurface mesh(W, H), drawn(W, H);
+                mesh.canvas()->drawMesh(verts, c, texs, 2, indices, paint);
+                drawn.canvas()->drawVertices(vertices, paint);
+                match &= max_pixel_diff(mesh.bitmap(), drawn.bitmap(), device, 4) <= 1;
+                const GPixel inside = *drawn.bitmap().getAddr(4, 4);
+                if (s) {
+                    drawsNothing &= inside == 0 && *drawn.bitmap().getAddr(20, 4) != 0;
+                } else if (c) {
+                    drawsColors &= inside != 0;
+                }
+            }
+        }
+    }
+    stats->expectTrue(kept, "vertices_degenerate_texs_kept");
+    stats->expectTrue(match, "vertices_degenerate_texs_match_mesh");
+    stats->expectTrue(drawsColors, "vertices_degenerate_texs_colors");
+    stats->expectTrue(drawsNothing, "vertices_degenerate_texs_shader");
+    free(tex.pixels());
+}
+
+// Draws each kind of shader, destroying every shader as soon as its draw returns (a deferred
+// canvas must keep its own copy), the last one along with its pixels.
+static void draw_shaded_scene(GCanvas* canvas, const GBitmap& texture) {
+    const GColor colors[] = { { 1, 1, 0, 0 }, { 0.6f, 0, 1, 0 }, { 1, 0, 0, 1 } };
+    canvas->clear({ 1, 0.9f, 0.9f, 0.9f });
+
+    canvas->save();
+    canvas->rotate(0.2f);
+    auto bitmap = GCreateBitmapShader(texture, GMatrix::MakeScale(0.7f), GShader::kMirror,
+                                      GShader::kBilinear);
+    canvas->drawRect(GRect::MakeXYWH(20, -10, 220, 200), GPaint(bitmap.get()).setAlpha(0.8f));
+    bitmap.reset();
+    canvas->restore();
+
+    auto linear = GCreateLinearGradient({ 10, 10 }, { 200, 90 }, colors, 3, GShader::kRepeat);
+    GPath path;
+    path.addCircle({ 150, 150 }, 90);
+    canvas->drawPath(path, GPaint(linear.get()).setBlendMode(GBlendMode::kSrcATop));
+    linear.reset();
+
+    auto radial = canvas->final_createRadialGradient({ 90, 180 }, 60, colors, 3,
+                                                    GShader::kMirror);
+    const GPoint poly[] = { { 5, 120 }, { 180, 100 }, { 160, 250 }, { 30, 240 } };
+    canvas->drawConvexPolygon(poly, 4, GPaint(radial.get()).setAntiAlias(true));
+    radial.reset();
+
+    auto tex = GCreateBitmapShader(texture, GMatrix(), GShader::kRepeat);
+    const GPoint quad[] = { { 100, 20 }, { 250, 40 }, { 240, 230 }, { 120, 200 } };
+    const GColor corners[] = { colors[0], colors[1], colors[2], colors[0] };
+    const GPoint texs[] = { { 0, 0 }, { 100, 0 }, { 100, 100 }, { 0, 100 } };
+    canvas->drawQuad(quad, corners, texs, 12, GPaint(tex.get()));
+    tex.reset();
+
+    {
+        // pixels on the stack, gone once the draw returns
+        GPixel pixels[] = { 0xFF0000FF, 0x80008000, 0x40400000, 0xFFFFFFFF };
+        GBitmap local(2, 2, 2 * sizeof(GPixel), pixels, false);
+        auto shader = GCreateBitmapShader(local, GMatrix::MakeScale(25));
+        canvas->drawRect(GRect::MakeXYWH(190, 190, 60, 60), GPaint(shader.get()));
+    }
+}
+
+// A deferred canvas (GCreateCanvas(bitmap, threads)) draws exactly the pixels of a plain one,
+// for every image rec and the shaded scene, at any number of threads.
+static void test_threads_identical(GTestStats* stats) {
+    GBitmap texture;
+    texture.alloc(40, 40);
+    GRandom rand;
+    for (int y = 0; y < texture.height(); ++y) {
+        for (int x = 0; x < texture.width(); ++x) {
+            *texture.getAddr(x, y) = rand.nextU() | 0xFF000000;
+        }
+    }
+
+    std::vector<GDrawRec> recs;
+    for (int i = 0; gDrawRecs[i].fDraw; ++i) {
+        recs.push_back(gDrawRecs[i]);
+    }
+    recs.push_back({ nullptr, 256, 256, "shaded_scene", 0 });  // draws the scene
+
+    for (const GDrawRec& rec : recs) {
+        auto render = [&rec, &texture](int threads) {
+            GBitmap bm;
+            bm.alloc(rec.fWidth, rec.fHeight);
+            auto canvas = threads ? GCreateCanvas(bm, threads) : GCreateCanvas(bm);
+            if (rec.fDraw) {
+                rec.fDraw(canvas.get());
+            } else {
+                draw_shaded_scene(canvas.get(), texture);
+            }
+            canvas->flush();
+            return bm;
+        };
+        GBitmap expected = render(0);
+        const size_t size = expected.rowBytes() * expected.height();
+        for (int threads : { 1, 3, 8 }) {
+            GBitmap bm = render(threads);
+            stats->expectTrue(!memcmp(expected.pixels(), bm.pixels(), size), rec.fName);
+            free(bm.pixels());
+        }
+        free(expected.pixels());
+    }
+    free(texture.pixels());
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "tests_pa3.cpp"
@@ -233,6 +1108,24 @@ const GTestRec gTestRecs[] = {
 
     { test_bad_input_poly, "poly_bad_input" },
     { test_offscreen_poly, "poly_offscreen" },
+    { test_aa_coverage, "aa_coverage" },
+    { test_aa_supersample, "aa_supersample" },
+    { test_blit_row_modes, "blit_row_modes" },
+    { test_gradient_rows, "gradient_rows" },
+    { test_bitmap_filter, "bitmap_filter" },
+    { test_bitmap_mipmap, "bitmap_mipmap" },
+    { test_bitmap_tiling, "bitmap_tiling" },
+    { test_bitmap_float_clamp, "bitmap_float_clamp" },
+    { test_bitmap_shader_opaque, "bitmap_shader_opaque" },
+    { test_context_set_ctm, "context_set_ctm" },
+    { test_span_at_width, "span_at_width" },
+    { test_mesh_compose_wide, "mesh_compose_wide" },
+    { test_mesh_coverage, "mesh_coverage" },
+    { test_mesh_watertight, "mesh_watertight" },
+    { test_quad_auto_level, "quad_auto_level" },
+    { test_draw_vertices, "draw_vertices" },
+    { test_vertices_degenerate_texs, "vertices_degenerate_texs" },
+    { test_threads_identical, "threads_identical" },
     
     { test_matrix,      "matrix_setters"    },
     { test_matrix_inv,  "matrix_inv"        },
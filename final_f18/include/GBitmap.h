@@ -13,6 +13,7 @@ public:
 
     GBitmap(int w, int h, size_t rb, GPixel* pixels, bool isOpaque)
         : fWidth(w), fHeight(h), fRowBytes(rb), fPixels(pixels), fIsOpaque(isOpaque)
+        , fGenerationID(NextGenerationID())
     {
         this->validate();
     }
@@ -23,12 +24,23 @@ public:
     GPixel* pixels() const { return fPixels; }
     bool isOpaque() const { return fIsOpaque; }
 
+    /**
+     *  Identifies the current pixels. Copies of a bitmap share its ID; setting new pixels (the
+     *  constructor, reset(...), alloc(), readFromFile()) or calling notifyPixelsChanged() gives
+     *  it a new one. Shaders share what they derive from pixels (opacity, mip levels) between
+     *  bitmaps with the same ID, so call notifyPixelsChanged() after editing pixels that a
+     *  shader has already been made for, before making another one.
+     */
+    uint32_t getGenerationID() const { return fGenerationID; }
+    void notifyPixelsChanged() { fGenerationID = NextGenerationID(); }
+
     void reset() {
         fWidth = 0;
         fHeight = 0;
         fPixels = NULL;
         fRowBytes = 0;
         fIsOpaque = false;  // unknown
+        fGenerationID = 0;
     }
 
     enum IsOpaque {
@@ -83,6 +95,7 @@ private:
     GPixel* fPixels;
     size_t  fRowBytes;
     bool    fIsOpaque;  // hint that all pixels have 0xFF for alpha
+    uint32_t fGenerationID;  // 0 for no pixels
 
     void validate() const {
         GASSERT(fWidth >= 0);
@@ -95,6 +108,7 @@ private:
     }
 
     static bool ComputeIsOpaque(const GBitmap&);
+    static uint32_t NextGenerationID();
 };
 
 template <typename S> void visit_pixels(const GBitmap& bm, S&& visitor) {
@@ -26,6 +26,7 @@
 #include "GMatrix.h"
 #include "GPaint.h"
 #include "GShader.h"
+#include "GVertices.h"
 
 class GBitmap;
 class GPath;
@@ -169,10 +170,32 @@ public:
      *      3---2
      *
      *  colors and/or texs can be null. The resulting triangles should be passed to drawMesh(...).
+     *
+     *  If level is kAutoQuadLevel (or any negative value), the canvas picks it from the quad as
+     *  it lands on the device under the current CTM: fine enough that the colors and texture
+     *  stay within about a pixel (and a color step) of the smooth bilinear patch, and no finer
+     *  than a pixel per cell, so a small quad gets few triangles.
      */
+    enum { kAutoQuadLevel = -1 };
+
     virtual void drawQuad(const GPoint verts[4], const GColor colors[4], const GPoint texs[4],
                           int level, const GPaint&) = 0;
 
+    /**
+     *  Draw a mesh made ahead of time (see GVertices), the same as drawMesh() with its arrays.
+     *  Canvases can reuse what the GVertices worked out for its triangles, so it is cheaper
+     *  than drawMesh() for a mesh drawn more than once, e.g. every frame under a new CTM. The
+     *  default calls drawMesh().
+     */
+    virtual void drawVertices(const GVertices&, const GPaint&);
+
+    /**
+     *  Make sure every draw issued so far has reached the bitmap. Canvases that defer drawing
+     *  (see GCreateCanvas(bitmap, threads)) need this before their pixels are read; for the
+     *  others it does nothing. Deferred canvases also flush when they are destroyed.
+     */
+    virtual void flush() {}
+
     // Helpers
 
     void translate(float x, float y) {
@@ -204,6 +227,13 @@ public:
  */
 std::unique_ptr<GCanvas> GCreateCanvas(const GBitmap& bitmap);
 
+/**
+ *  Like GCreateCanvas(bitmap), but the canvas records draws and rasterizes them in horizontal
+ *  bands on [threads] threads (counting the caller) when flush() is called. The pixels are
+ *  identical to the single-threaded canvas. Returns NULL if threads < 1.
+ */
+std::unique_ptr<GCanvas> GCreateCanvas(const GBitmap& bitmap, int threads);
+
 /**
  *  Implement this, and draw something interesting with polygons, matrices, and shaders.
  *  Dimensions = 512 x 512
@@ -0,0 +1,45 @@
+#ifndef GCpu_DEFINED
+#define GCpu_DEFINED
+
+#include "GPixel.h"
+
+/**
+ *  Instruction set levels the pixel kernels are built for, from least to most capable.
+ */
+enum class GCpuLevel {
+    kScalar,    //!< plain C++
+    kSSE2,      //!< 4 pixels per step
+    kAVX2,      //!< 8 pixels per step
+    kAVX512,    //!< 16 pixels per step (AVX-512 BW)
+};
+
+/**
+ *  Returns the level whose kernels are in use. This is the best level the CPU supports, picked
+ *  the first time it is asked for. Setting the environment variable G_CPU_LEVEL to scalar, sse2,
+ *  avx2 or avx512 forces that level instead, as long as the CPU supports it.
+ */
+GCpuLevel GGetCpuLevel();
+
+/**
+ *  Returns "scalar", "sse2", "avx2" or "avx512".
+ */
+const char* GCpuLevelName(GCpuLevel);
+
+/**
+ *  The kernels chosen for GGetCpuLevel().
+ *
+ *  Only these row kernels are dispatched at runtime. Vector code inside the shaders is chosen
+ *  at compile time (#if defined(__SSE2__), the x86-64 baseline): it has no AVX2/AVX-512
+ *  versions, and G_CPU_LEVEL does not switch it.
+ */
+struct GCpuProcs {
+    // blends one premultiplied color into count pixels, indexed by GBlendMode
+    void (*blendRow[12])(GPixel src, GPixel dst[], int count);
+
+    // converts count unpremultiplied RGBA8888 pixels (as stored in PNG) to GPixels
+    void (*premulRGBA)(GPixel dst[], const uint8_t src[], int count);
+};
+
+const GCpuProcs& GCpu();
+
+#endif
@@ -31,10 +31,35 @@ public:
     GShader* getShader() const { return fShader; }
     GPaint&  setShader(GShader* s) { fShader = s; return *this; }
 
+    /**
+     *  Returns true if every color this paint draws with is opaque: the color's alpha is 1, or
+     *  the shader (if there is one) reports that it is opaque.
+     */
+    bool isOpaque() const;
+
+    /**
+     *  When set, drawRect, drawConvexPolygon and drawPath compute the exact area of each pixel
+     *  covered by the geometry and blend partially covered pixels by that amount, instead of
+     *  sampling at pixel centers.
+     */
+    bool    isAntiAlias() const { return fAntiAlias; }
+    GPaint& setAntiAlias(bool aa) { fAntiAlias = aa; return *this; }
+
+    /**
+     *  With anti-aliasing on, a sample count of 4 or 16 supersamples each pixel on a 2x2 or 4x4
+     *  grid instead of computing its exact coverage: cheaper, at some cost in quality.
+     *  0 (the default) keeps exact coverage. Devices wider than 8191 pixels draw 16 as 4, and
+     *  ones wider than 16383 keep exact coverage.
+     */
+    int     getSampleCount() const { return fSampleCount; }
+    GPaint& setSampleCount(int samples) { fSampleCount = samples; return *this; }
+
 private:
     GColor      fColor = GColor::MakeARGB(1, 0, 0, 0);
     GShader*    fShader = nullptr;
     GBlendMode  fMode = GBlendMode::kSrcOver;
+    bool        fAntiAlias = false;
+    int         fSampleCount = 0;
 };
 
 #endif
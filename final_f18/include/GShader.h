@@ -5,7 +5,9 @@
 #ifndef GShader_DEFINED
 #define GShader_DEFINED
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 #include "GColor.h"
 #include "GPixel.h"
 #include "GPoint.h"
@@ -24,6 +26,20 @@ public:
         kMirror,
     };
 
+    /**
+     *  How a bitmap shader computes a color between the bitmap's pixels.
+     *  kNearest takes the pixel the sample falls in.
+     *  kBilinear blends the 2x2 pixels around it.
+     *  kBicubic blends the 4x4 pixels around it with a cubic (Mitchell) filter.
+     *  When the bitmap is drawn scaled down, kBilinear and kBicubic sample a copy halved as
+     *  many times as it takes for its pixels to be about the size of a device pixel.
+     */
+    enum FilterQuality {
+        kNearest,
+        kBilinear,
+        kBicubic,
+    };
+
     virtual ~GShader() {}
 
     // Return true iff all of the GPixels that may be returned by this shader will be opaque.
@@ -38,14 +54,117 @@ public:
      *  can hold at least [count] entries.
      */
     virtual void shadeRow(int x, int y, int count, GPixel row[]) = 0;
+
+    /**
+     *  Rows of pixels a canvas lends to the contexts it draws with, for colors they need to
+     *  hold between shading and blending (e.g. both halves of a compose). A canvas makes one,
+     *  sized for its width, and keeps it for all of its draws: rows are taken and given back in
+     *  stack order, so nested contexts share them, and once they exist shading allocates
+     *  nothing. Not thread safe; each canvas (or band of a canvas) has its own.
+     */
+    class Scratch {
+    public:
+        explicit Scratch(int width = 0) : fWidth(width), fDepth(0) {}
+
+        /** A row of at least count pixels, valid until the Row goes out of scope. */
+        class Row {
+        public:
+            Row(Scratch* scratch, int count) : fScratch(scratch) {
+                fPixels = scratch->push(count);
+            }
+            ~Row() { fScratch->fDepth -= 1; }
+
+            GPixel* get() const { return fPixels; }
+
+        private:
+            Row(const Row&) = delete;
+            Row& operator=(const Row&) = delete;
+
+            Scratch* fScratch;
+            GPixel* fPixels;
+        };
+
+    private:
+        GPixel* push(int count) {
+            if (fDepth == (int)fRows.size()) {
+                fRows.emplace_back();
+            }
+            std::vector<GPixel>& row = fRows[fDepth++];
+            if ((int)row.size() < count) {
+                row.resize(std::max(count, fWidth));
+            }
+            return row.data();
+        }
+
+        // each row keeps its own buffer, so adding or growing one never moves the others
+        std::vector<std::vector<GPixel>> fRows;
+        int fWidth;
+        int fDepth;
+    };
+
+    /**
+     *  A shader's state for drawing with one CTM: the inverse matrix and whatever the shader
+     *  can precompute from it. A canvas makes one per draw and asks it for every row.
+     */
+    class Context {
+    public:
+        virtual ~Context() {}
+
+        // Same contract as GShader::shadeRow().
+        virtual void shadeRow(int x, int y, int count, GPixel row[]) = 0;
+
+        enum Flags {
+            /** Every pixel of a row has the same color, so shading one is enough. */
+            kConstantRow_Flag = 1 << 0,
+        };
+
+        /** Return a combination of Flags that is true of every row this context shades. */
+        virtual unsigned flags() const { return 0; }
+
+        /**
+         *  Lends the context the canvas's scratch rows for as long as it is drawn with; called
+         *  before any shadeRow(). Contexts that need temporary rows take them from here rather
+         *  than the stack; without a call they fall back to rows of their own.
+         */
+        virtual void setScratch(Scratch*) {}
+
+        /**
+         *  Points the context at another CTM: afterwards it shades what a context made by
+         *  makeContext(ctm) would, without making a new one. For callers that draw with one
+         *  shader through many matrices, e.g. the triangles of a textured mesh. Returns false
+         *  if it cannot, because the matrix is not invertible or the context does not support
+         *  it (the default); it must then not shade until a later call returns true, and the
+         *  caller makes a new context instead.
+         */
+        virtual bool setCTM(const GMatrix&) { return false; }
+    };
+
+    /**
+     *  Return a context for drawing with the given CTM, or null if the shader cannot draw with
+     *  it (e.g. the matrix is not invertible). Contexts made by the built-in shaders do not
+     *  touch the shader itself, so any number of them may be alive at once. The default calls
+     *  setContext() and forwards rows to shadeRow().
+     */
+    virtual std::unique_ptr<Context> makeContext(const GMatrix& ctm);
+
+    /**
+     *  Return a shader that draws the same as this one and shares nothing the caller may change
+     *  or free (a bitmap shader copies its pixels), for canvases that rasterize after the draw
+     *  call returns (see GCreateCanvas(bitmap, threads)). Contexts of the copy may be made and
+     *  used on several threads at once. Returns null if the shader cannot be copied (the
+     *  default); such canvases then draw with it before the call returns.
+     */
+    virtual std::unique_ptr<GShader> clone() const { return nullptr; }
 };
 
 /**
- *  Return a subclass of GShader that draws the specified bitmap and a local matrix.
+ *  Return a subclass of GShader that draws the specified bitmap and a local matrix, sampled
+ *  with the given filter quality.
  *  Returns null if the either parameter is invalid.
  */
 std::unique_ptr<GShader> GCreateBitmapShader(const GBitmap&, const GMatrix& localMatrix,
-                                             GShader::TileMode = GShader::kClamp);
+                                             GShader::TileMode = GShader::kClamp,
+                                             GShader::FilterQuality = GShader::kNearest);
 
 /**
  *  Return a subclass of GShader that draws the specified gradient of [count] colors between
@@ -0,0 +1,102 @@
+#ifndef GVertices_DEFINED
+#define GVertices_DEFINED
+
+#include <memory>
+#include <vector>
+#include "GColor.h"
+#include "GMatrix.h"
+#include "GPoint.h"
+#include "GRect.h"
+
+/**
+ *  An immutable triangle mesh, for GCanvas::drawVertices(): positions, optional colors and
+ *  texture coordinates, and the indices of the triangles (3 per triangle, as in drawMesh).
+ *
+ *  Making one copies the arrays and works out, once, everything a triangle needs for shading
+ *  that does not depend on the CTM. A mesh redrawn from frame to frame under a changing CTM
+ *  only pays for that once. Copies of a GVertices share the same (immutable) data.
+ */
+class GVertices {
+public:
+    /**
+     *  How one triangle's colors vary over the mesh's own (pre-CTM) coordinates: the color at
+     *  (x, y) is fColor + x * fDX + y * fDY.
+     */
+    struct ColorSetup {
+        GColor fColor;
+        GColor fDX;
+        GColor fDY;
+    };
+
+    /**
+     *  An empty mesh, which draws nothing.
+     */
+    GVertices() {}
+
+    /**
+     *  Copy the mesh. colors and/or texs may be null. Triangles that have no area can never
+     *  draw anything, and are left out. Ones whose texture coordinates have no area are kept:
+     *  drawn without a shader they still draw their colors (see texMatrixIsValid()).
+     */
+    static GVertices Make(const GPoint verts[], const GColor colors[], const GPoint texs[],
+                          int vertexCount, const int indices[], int triangleCount);
+
+    int vertexCount() const { return fData ? (int)fData->fPts.size() : 0; }
+    int triangleCount() const { return fData ? (int)fData->fIndices.size() / 3 : 0; }
+
+    const GPoint* positions() const { return fData ? fData->fPts.data() : nullptr; }
+    const int* indices() const { return fData ? fData->fIndices.data() : nullptr; }
+
+    /**
+     *  Null if the mesh was made without colors (or texture coordinates).
+     */
+    const GColor* colors() const { return Get(fData ? &fData->fColors : nullptr); }
+    const GPoint* texs() const { return Get(fData ? &fData->fTexs : nullptr); }
+
+    /**
+     *  Per triangle, in the order of indices(): how its colors vary (null without colors), and
+     *  the matrix that maps texture coordinates onto it (null without texture coordinates).
+     */
+    const ColorSetup* colorSetups() const { return Get(fData ? &fData->fColorSetups : nullptr); }
+    const GMatrix* texMatrices() const { return Get(fData ? &fData->fTexMatrices : nullptr); }
+
+    /**
+     *  False if the triangle's texture coordinates have no area, so no texture maps onto it
+     *  and its texture matrix is meaningless: drawn with a shader, as in drawMesh(), the
+     *  triangle draws nothing. True if the mesh has no texture coordinates.
+     */
+    bool texMatrixIsValid(int triangle) const {
+        return !fData || fData->fTexMatrixValid.empty() || fData->fTexMatrixValid[triangle];
+    }
+
+    /**
+     *  True if every color is opaque (or there are no colors).
+     */
+    bool colorsAreOpaque() const { return !fData || fData->fColorsAreOpaque; }
+
+    /**
+     *  The bounds of the positions, or {0, 0, 0, 0} if there are none.
+     */
+    GRect bounds() const { return fData ? fData->fBounds : GRect::MakeWH(0, 0); }
+
+private:
+    struct Data {
+        std::vector<GPoint> fPts;
+        std::vector<GColor> fColors;
+        std::vector<GPoint> fTexs;
+        std::vector<int> fIndices;
+        std::vector<ColorSetup> fColorSetups;
+        std::vector<GMatrix> fTexMatrices;
+        std::vector<bool> fTexMatrixValid;
+        bool fColorsAreOpaque;
+        GRect fBounds;
+    };
+
+    template <typename T> static const T* Get(const std::vector<T>* array) {
+        return array && !array->empty() ? array->data() : nullptr;
+    }
+
+    std::shared_ptr<const Data> fData;
+};
+
+#endif
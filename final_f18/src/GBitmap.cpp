@@ -4,6 +4,16 @@
 
 #include "GBitmap.h"
 #include "lodepng.h"
+#include <atomic>
+
+uint32_t GBitmap::NextGenerationID() {
+    static std::atomic<uint32_t> gNextID(1);
+    uint32_t id;
+    do {
+        id = gNextID++;
+    } while (id == 0);
+    return id;
+}
 
 void GBitmap::setIsOpaque(IsOpaque io) {
     switch (io) {
@@ -18,6 +28,7 @@ void GBitmap::reset(int w, int h, size_t rb, GPixel* pixels, IsOpaque io) {
     fHeight = h;
     fRowBytes = rb;
     fPixels = pixels;
+    fGenerationID = NextGenerationID();
     this->setIsOpaque(io);
     this->validate();
 }
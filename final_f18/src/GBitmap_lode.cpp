@@ -3,6 +3,7 @@
  */
 
 #include "GBitmap.h"
+#include "GCpu.h"
 #include "lodepng.h"
 
 static void convertToPNG(const GPixel src[], int width, uint8_t dst[]) {
@@ -48,21 +49,6 @@ bool GBitmap::writeToFile(const char path[]) const {
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static int alpha_mul(unsigned a, unsigned c) {
-    return (a * c + 127) / 255;
-}
-
-static void swizzle_rgba_row(GPixel dst[], const uint8_t src[], int count) {
-    for (int i = 0; i < count; ++i) {
-        unsigned a = src[3];
-        dst[i] = GPixel_PackARGB(a,
-                                 alpha_mul(a, src[0]),
-                                 alpha_mul(a, src[1]),
-                                 alpha_mul(a, src[2]));
-        src += 4;
-    }
-}
-
 bool GBitmap::readFromFile(const char path[]) {
     unsigned w, h;
     unsigned char* pix = nullptr;
@@ -77,11 +63,13 @@ bool GBitmap::readFromFile(const char path[]) {
     const uint8_t* src = pix;
     size_t rb = w * 4;
     for (unsigned y = 0; y < h; ++y) {
-        swizzle_rgba_row(dst, src, w);
+        GCpu().premulRGBA(dst, src, w);
         src += rb;
         dst += this->rowBytes() / 4;
     }
     free(pix);
+    // shaders of this bitmap can then tell that it is opaque without looking at its pixels
+    this->computeIsOpaque();
     return true;
 }
 
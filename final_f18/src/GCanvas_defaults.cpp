@@ -10,3 +10,32 @@ std::unique_ptr<GShader> GCanvas::final_createRadialGradient(GPoint center, floa
                                                              GShader::TileMode) {
     return nullptr;
 }
+
+void GCanvas::drawVertices(const GVertices& vertices, const GPaint& paint) {
+    this->drawMesh(vertices.positions(), vertices.colors(), vertices.texs(),
+                   vertices.triangleCount(), vertices.indices(), paint);
+}
+
+// Shaders that only implement setContext()/shadeRow() keep their state in the shader.
+class LegacyShaderContext : public GShader::Context {
+public:
+    LegacyShaderContext(GShader* shader) : fShader(shader) {}
+
+    void shadeRow(int x, int y, int count, GPixel row[]) override {
+        fShader->shadeRow(x, y, count, row);
+    }
+
+    bool setCTM(const GMatrix& ctm) override {
+        return fShader->setContext(ctm);
+    }
+
+private:
+    GShader* fShader;
+};
+
+std::unique_ptr<GShader::Context> GShader::makeContext(const GMatrix& ctm) {
+    if (!this->setContext(ctm)) {
+        return nullptr;
+    }
+    return std::unique_ptr<Context>(new LegacyShaderContext(this));
+}
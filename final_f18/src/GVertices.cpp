@@ -0,0 +1,87 @@
+/*
+ *  Copyright 2018 Mike Reed
+ */
+
+#include "GVertices.h"
+#include <algorithm>
+
+// a + s * b, per component
+static GColor color_mad(const GColor& a, float s, const GColor& b) {
+    return GColor::MakeARGB(a.fA + s * b.fA, a.fR + s * b.fR, a.fG + s * b.fG, a.fB + s * b.fB);
+}
+
+// The matrix taking (u, v), the coordinates along the sides p0->p1 and p0->p2, to the plane.
+static GMatrix triangle_basis(const GPoint& p0, const GPoint& p1, const GPoint& p2) {
+    GMatrix m;
+    m.set6(p1.fX - p0.fX, p2.fX - p0.fX, p0.fX, p1.fY - p0.fY, p2.fY - p0.fY, p0.fY);
+    return m;
+}
+
+GVertices GVertices::Make(const GPoint verts[], const GColor colors[], const GPoint texs[],
+                          int vertexCount, const int indices[], int triangleCount) {
+    std::shared_ptr<Data> data(new Data);
+    data->fPts.assign(verts, verts + vertexCount);
+    if (colors) {
+        data->fColors.assign(colors, colors + vertexCount);
+    }
+    if (texs) {
+        data->fTexs.assign(texs, texs + vertexCount);
+    }
+
+    data->fColorsAreOpaque = true;
+    for (int i = 0; colors && i < vertexCount; ++i) {
+        data->fColorsAreOpaque &= colors[i].fA >= 1;
+    }
+
+    GRect bounds = GRect::MakeWH(0, 0);
+    if (vertexCount > 0) {
+        bounds = GRect::MakeLTRB(verts[0].fX, verts[0].fY, verts[0].fX, verts[0].fY);
+        for (int i = 1; i < vertexCount; ++i) {
+            bounds.fLeft = std::min(bounds.fLeft, verts[i].fX);
+            bounds.fTop = std::min(bounds.fTop, verts[i].fY);
+            bounds.fRight = std::max(bounds.fRight, verts[i].fX);
+            bounds.fBottom = std::max(bounds.fBottom, verts[i].fY);
+        }
+    }
+    data->fBounds = bounds;
+
+    for (int i = 0; i < triangleCount; ++i) {
+        const int* tri = indices + 3 * i;
+        GMatrix basis = triangle_basis(verts[tri[0]], verts[tri[1]], verts[tri[2]]);
+        GMatrix toUV;
+        if (!basis.invert(&toUV)) {
+            continue;
+        }
+
+        data->fIndices.insert(data->fIndices.end(), tri, tri + 3);
+        if (texs) {
+            // texture space -> (u, v) -> the plane; left as the identity when the texture
+            // coordinates have no area, and marked invalid
+            GMatrix texMatrix, fromTex;
+            bool valid = triangle_basis(texs[tri[0]], texs[tri[1]], texs[tri[2]]).invert(&fromTex);
+            if (valid) {
+                texMatrix.setConcat(basis, fromTex);
+            }
+            data->fTexMatrices.push_back(texMatrix);
+            data->fTexMatrixValid.push_back(valid);
+        }
+        if (colors) {
+            // colors[0] + u * (colors[1] - colors[0]) + v * (colors[2] - colors[0]), with u and
+            // v expanded in terms of x and y
+            const GColor& c0 = colors[tri[0]];
+            GColor dc1 = color_mad(colors[tri[1]], -1, c0);
+            GColor dc2 = color_mad(colors[tri[2]], -1, c0);
+            ColorSetup setup;
+            setup.fColor = color_mad(color_mad(c0, toUV[GMatrix::TX], dc1), toUV[GMatrix::TY], dc2);
+            setup.fDX = color_mad(GColor::MakeARGB(0, 0, 0, 0), toUV[GMatrix::SX], dc1);
+            setup.fDX = color_mad(setup.fDX, toUV[GMatrix::KY], dc2);
+            setup.fDY = color_mad(GColor::MakeARGB(0, 0, 0, 0), toUV[GMatrix::KX], dc1);
+            setup.fDY = color_mad(setup.fDY, toUV[GMatrix::SY], dc2);
+            data->fColorSetups.push_back(setup);
+        }
+    }
+
+    GVertices vertices;
+    vertices.fData = data;
+    return vertices;
+}